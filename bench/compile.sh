@@ -0,0 +1,75 @@
+#!/bin/bash
+# throughput of tpcc on generated programs growing along each dimension
+# usage: bench/compile.sh BIN_DIR OUT_DIR [SCALE]
+# each dimension is compiled at 1, 2, 4 and 8 times its base size (multiplied by SCALE),
+# the best of REPEAT runs is kept, and a time growing faster than the size is flagged
+
+BIN_DIR=$1
+OUT_DIR=$2
+SCALE=${3:-1}
+REPEAT=${REPEAT:-3}
+
+# time(8n) / time(n) above 8^LIMIT is flagged
+LIMIT=1.3
+
+# dimension, base size, the parts of the compiler it mostly stresses
+DIMENSIONS=(
+    "globals 250 symbol_table_buckets"
+    "functions 100 function_table,call_graph"
+    "body 500 addSibling,instruction_lists"
+    "expression 100 expression_stack,recursion"
+    "switch 250 duplicate_case_check"
+    "nesting 100 labels,control_flow_graph"
+)
+
+# seconds and peak RSS in kB of the fastest run, from --time-report=json
+measure() {
+    file=$1
+    best=""
+    for ((r = 0; r < REPEAT; r++)); do
+        report=$(./${BIN_DIR}/tpcc --time-report=json $file 2>&1 >/dev/null) || {
+            echo "tpcc failed on $file" >&2
+            exit 1
+        }
+        seconds=$(echo "$report" | sed -n '/"total"/s/.*"seconds": \([0-9.]*\).*/\1/p')
+        rss=$(echo "$report" | sed -n 's/.*"peak_rss_kb": \([0-9]*\).*/\1/p')
+        if [[ -z $best ]] || awk -v a=$seconds -v b=$best 'BEGIN { exit !(a < b) }'; then
+            best=$seconds
+            best_rss=$rss
+        fi
+    done
+    echo "$best $best_rss"
+}
+
+printf "%-11s %8s %8s %10s %10s %12s %8s %12s\n" dimension size lines bytes seconds lines/s MB/s peak_rss_kb
+
+for entry in "${DIMENSIONS[@]}"; do
+    read dimension base components <<< "$entry"
+    first=""
+    for factor in 1 2 4 8; do
+        size=$((base * SCALE * factor))
+        file=$OUT_DIR/bench_compile_${dimension}_$size.tpc
+        ./bench/generate.sh $dimension $size > $file || exit 1
+
+        lines=$(wc -l < $file)
+        bytes=$(wc -c < $file)
+        read seconds rss <<< "$(measure $file)"
+        [[ -z $seconds ]] && exit 1
+        [[ -z $first ]] && first=$seconds
+        last=$seconds
+
+        awk -v d=$dimension -v s=$size -v l=$lines -v b=$bytes -v t=$seconds -v m=$rss 'BEGIN {
+            if (t <= 0) t = 1e-9
+            printf "%-11s %8d %8d %10d %10.6f %12.0f %8.2f %12d\n", d, s, l, b, t, l / t, b / t / 1e6, m
+        }'
+    done
+
+    awk -v d=$dimension -v a=$first -v b=$last -v limit=$LIMIT -v c=$components 'BEGIN {
+        if (a <= 0) a = 1e-9
+        exponent = log(b / a) / log(8)
+        gsub(",", ", ", c)
+        printf "%-11s time ~ size^%.2f", d, exponent
+        if (exponent > limit) printf "  SUPERLINEAR, look at %s", c
+        printf "\n\n"
+    }'
+done
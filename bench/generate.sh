@@ -0,0 +1,112 @@
+#!/bin/bash
+# writes on the standard output a TPC program of SIZE elements along one dimension
+# usage: bench/generate.sh DIMENSION SIZE
+#   globals     SIZE global variables, all read by main
+#   functions   SIZE functions, each called once
+#   body        a main of SIZE statements
+#   expression  an expression SIZE operators deep
+#   switch      a switch of SIZE cases
+#   nesting     SIZE nested if and while
+
+DIMENSION=$1
+SIZE=$2
+
+if [[ -z $DIMENSION || -z $SIZE ]]; then
+    echo "usage: $0 DIMENSION SIZE" >&2
+    exit 2
+fi
+
+awk -v dimension=$DIMENSION -v n=$SIZE '
+function main_start() {
+    print "int main(void) {"
+    print "    int x, y, i;"
+    print "    x = getint();"
+    print "    y = 0;"
+    print "    i = 0;"
+}
+
+function main_end() {
+    print "    putint(x);"
+    print "    putint(y);"
+    print "    return 0;"
+    print "}"
+}
+
+BEGIN {
+    print "/* " dimension " " n " */"
+    print ""
+
+    if (dimension == "globals") {
+        for (i = 0; i < n; i++) print (i % 4 == 3 ? "char" : "int") " g" i ";"
+        print ""
+        main_start()
+        for (i = 0; i < n; i++) print "    g" i " = " (i % 4 == 3 ? "\x27c\x27" : "x + " i) ";"
+        for (i = 0; i < n; i++) print "    y = y + g" i ";"
+        main_end()
+    }
+    else if (dimension == "functions") {
+        for (i = 0; i < n; i++) {
+            print "int f" i "(int a, int b) {"
+            print "    if (a < b) {"
+            print "        return a * " i " + b;"
+            print "    }"
+            print "    return a - b % " (i % 7 + 2) ";"
+            print "}"
+            print ""
+        }
+        main_start()
+        for (i = 0; i < n; i++) print "    y = y + f" i "(x, y);"
+        main_end()
+    }
+    else if (dimension == "body") {
+        main_start()
+        for (i = 0; i < n; i++) {
+            if (i % 4 == 0) print "    x = x + " i ";"
+            else if (i % 4 == 1) print "    y = y - x * " i % 13 ";"
+            else if (i % 4 == 2) print "    if (x > y) { y = y + 1; } else { x = x - 1; }"
+            else print "    putint(x + y);"
+        }
+        main_end()
+    }
+    else if (dimension == "expression") {
+        main_start()
+        line = "    y = "
+        for (i = 0; i < n; i++) line = line "("
+        line = line "x"
+        for (i = 0; i < n; i++) line = line (i % 3 == 0 ? " + " : i % 3 == 1 ? " * " : " - ") (i % 3 == 1 ? "x" : i) ")"
+        print line ";"
+        main_end()
+    }
+    else if (dimension == "switch") {
+        main_start()
+        print "    switch (x) {"
+        for (i = 0; i < n; i++) {
+            print "    case " i ":"
+            print "        y = y + " i ";"
+            print "        break;"
+        }
+        print "    default:"
+        print "        y = -1;"
+        print "    }"
+        main_end()
+    }
+    else if (dimension == "nesting") {
+        main_start()
+        indent = "    "
+        for (i = 0; i < n; i++) {
+            print indent (i % 2 == 0 ? "if (x > " i ") {" : "while (i < " i ") {")
+            indent = indent "    "
+            if (i % 2 == 1) print indent "i = i + 1;"
+        }
+        print indent "y = y + x;"
+        for (i = 0; i < n; i++) {
+            indent = substr(indent, 5)
+            print indent "}"
+        }
+        main_end()
+    }
+    else {
+        print "unknown dimension " dimension > "/dev/stderr"
+        exit 2
+    }
+}'
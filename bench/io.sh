@@ -0,0 +1,38 @@
+#!/bin/bash
+# throughput of getint and putint over COUNT integers (100M by default)
+# usage: bench/io.sh BIN_DIR OUT_DIR [COUNT]
+
+BIN_DIR=$1
+OUT_DIR=$2
+COUNT=${3:-100000000}
+
+INPUT=$OUT_DIR/bench_io_$COUNT.txt
+
+build() {
+    name=$1
+    ./${BIN_DIR}/tpcc bench/io/$name.tpc || exit 1
+    nasm -f elf64 -o $OUT_DIR/utils.o src/utils.asm || exit 1
+    nasm -f elf64 -o $OUT_DIR/bench_$name.o bin/_anonymous.asm || exit 1
+    ld -static -o $OUT_DIR/bench_$name $OUT_DIR/utils.o $OUT_DIR/bench_$name.o || exit 1
+}
+
+# the count then the integers, varied lengths, signs and blanks
+if [[ ! -f $INPUT ]]; then
+    awk -v n=$COUNT 'BEGIN {
+        print n
+        x = 1
+        for (i = 0; i < n; i++) {
+            x = (x * 16807) % 2147483647
+            printf "%d%s", (x % 3 ? 1 : -1) * int(x / 10 ^ (x % 10)), (i % 8 == 7 ? "\n" : " ")
+        }
+    }' > $INPUT
+fi
+
+build getint
+build putint
+
+echo "getint: $COUNT integers"
+time ./$OUT_DIR/bench_getint < $INPUT > /dev/null
+
+echo "putint: $COUNT integers"
+time (echo $COUNT | ./$OUT_DIR/bench_putint > /dev/null)
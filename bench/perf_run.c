@@ -0,0 +1,99 @@
+/* runs a program on the standard input and output it is given, then writes on the
+ * standard error its wall time in seconds, and the instructions and cycles it
+ * spent in user space, - for a counter the machine does not provide
+ * usage: perf_run PROGRAM [ARGUMENTS] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// counting starts when the child calls exec, so the fork and the wait are left out
+static int open_counter(pid_t pid, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+static void print_counter(int fd) {
+    uint64_t value;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        fprintf(stderr, " -");
+    }
+    else {
+        fprintf(stderr, " %llu", (unsigned long long)value);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s PROGRAM [ARGUMENTS]\n", argv[0]);
+        return 2;
+    }
+
+    // the child waits until the counters are attached to it
+    int start[2];
+    if (pipe(start) == -1) {
+        perror("pipe");
+        return 3;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return 3;
+    }
+    if (pid == 0) {
+        char go;
+        close(start[1]);
+        if (read(start[0], &go, 1) != 1) _exit(3);
+        close(start[0]);
+        execv(argv[1], argv + 1);
+        perror(argv[1]);
+        _exit(3);
+    }
+
+    close(start[0]);
+    int instructions = open_counter(pid, PERF_COUNT_HW_INSTRUCTIONS);
+    int cycles = open_counter(pid, PERF_COUNT_HW_CPU_CYCLES);
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (write(start[1], "", 1) != 1) {
+        perror("write");
+        return 3;
+    }
+    close(start[1]);
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        return 3;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(stderr, "%.6f", (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9);
+    print_counter(instructions);
+    print_counter(cycles);
+    fprintf(stderr, "\n");
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#!/bin/bash
+# speed of the code tpcc generates for the programs of bench/run, at each optimization level
+# usage: bench/run.sh BIN_DIR OUT_DIR [REPEAT]
+# every program is assembled and linked as make compile_asm does, then run REPEAT times
+# (5 by default) through perf_run, the fastest run is kept; the outputs of all the levels
+# must be the same
+#   LEVELS    the levels to compare, "-O0 -O1" by default
+#   BASELINE  results to compare with, OUT_DIR/bench_run_baseline.txt by default
+#   SAVE=1    saves these results as the baseline
+
+BIN_DIR=$1
+OUT_DIR=$2
+REPEAT=${3:-5}
+LEVELS=${LEVELS:--O0 -O1}
+BASELINE=${BASELINE:-$OUT_DIR/bench_run_baseline.txt}
+
+RESULTS=$OUT_DIR/bench_run_results.txt
+FILTER_INPUT=$OUT_DIR/bench_run_filter.txt
+
+# filter reads a count of lines then words of varied lengths separated by blanks
+if [[ ! -f $FILTER_INPUT ]]; then
+    awk 'BEGIN {
+        n = 500000
+        print n
+        x = 1
+        for (i = 0; i < n; i++) {
+            line = ""
+            for (w = 0; w < 8; w++) {
+                x = (x * 16807) % 2147483647
+                word = substr("the quick brown fox jumps over a lazy dog", x % 30 + 1, x % 7 + 1)
+                line = line word (x % 5 ? " " : "  \t ")
+            }
+            print line
+        }
+    }' > $FILTER_INPUT
+fi
+
+# the steps of compile_asm, the target itself would rebuild tpcc as it shares obj/utils.o
+build() {
+    name=$1
+    level=$2
+    program=$OUT_DIR/bench_run_$name$level
+    ./${BIN_DIR}/tpcc $level bench/run/$name.tpc || exit 1
+    nasm -f elf64 -o $OUT_DIR/utils.o src/utils.asm || exit 1
+    nasm -f elf64 -o $program.o bin/_anonymous.asm || exit 1
+    ld -static -o $program $OUT_DIR/utils.o $program.o || exit 1
+}
+
+input() {
+    [[ $1 == filter ]] && echo $FILTER_INPUT || echo /dev/null
+}
+
+# seconds, instructions and cycles of the fastest run
+measure() {
+    program=$1
+    name=$2
+    output=$3
+    best=""
+    for ((r = 0; r < REPEAT; r++)); do
+        result=$(./${BIN_DIR}/perf_run $program < $(input $name) 2>&1 > $output) || {
+            echo "$result" >&2
+            return 1
+        }
+        read seconds instructions cycles <<< "$result"
+        if [[ -z $best ]] || awk -v a=$seconds -v b=$best 'BEGIN { exit !(a < b) }'; then
+            best=$seconds
+            best_instructions=$instructions
+            best_cycles=$cycles
+        fi
+    done
+    echo "$best $best_instructions $best_cycles"
+}
+
+> $RESULTS
+printf "%-14s %-5s %10s %14s %14s %9s %9s\n" program level seconds instructions cycles speedup baseline
+
+for file in bench/run/*.tpc; do
+    name=$(basename $file .tpc)
+    first=""
+    for level in $LEVELS; do
+        build $name $level
+        program=$OUT_DIR/bench_run_$name$level
+
+        output=$program.out
+        read seconds instructions cycles <<< "$(measure $program $name $output)"
+        [[ -z $seconds ]] && exit 1
+        echo "$name $level $seconds $instructions $cycles" >> $RESULTS
+
+        # the speedup is against the first level, the baseline column is the ratio of the times
+        if [[ -z $first ]]; then
+            first=$seconds
+            first_output=$output
+        elif ! cmp -s $first_output $output; then
+            echo "$name: the output at $level differs from the one at ${LEVELS%% *}" >&2
+            exit 1
+        fi
+        saved=$([[ -f $BASELINE ]] && awk -v n=$name -v l=$level '$1 == n && $2 == l { print $3 }' $BASELINE)
+
+        awk -v n=$name -v l=$level -v t=$seconds -v i=$instructions -v c=$cycles -v f=$first -v s="$saved" 'BEGIN {
+            printf "%-14s %-5s %10.6f %14s %14s %8.2fx", n, l, t, i, c, f / t
+            if (s != "") printf " %8.2fx", t / s
+            else printf " %9s", "-"
+            printf "\n"
+        }'
+    done
+done
+
+if [[ $SAVE == 1 ]]; then
+    cp $RESULTS $BASELINE
+    echo "baseline saved in $BASELINE"
+fi
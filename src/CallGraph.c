@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "CallGraph.h"
+
+// declare_functions stores the index of each function in its symbol address,
+// builtins keep -1
+int call_graph_index(CallGraph* graph, SymbolTable* global, char* name) {
+    if (!table_contains(global, name)) return -1;
+
+    Type type = table_get_type(global, name);
+    if (type.type != TYPE_FUNCTION) return -1;
+
+    int index = table_get_address(global, name);
+    if (index < 0 || index >= graph->count) return -1;
+
+    return index;
+}
+
+CallGraphNode* call_graph_get(CallGraph* graph, SymbolTable* global, char* name) {
+    int index = call_graph_index(graph, global, name);
+    return index == -1 ? NULL : &graph->nodes[index];
+}
+
+int count_nodes(Node* node) {
+    if (node == NULL) return 0;
+
+    int count = 1;
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        count += count_nodes(child);
+    }
+    return count;
+}
+
+static void add_callee(CallGraphNode* node, int callee) {
+    if (node->callees_count == node->callees_capacity) {
+        node->callees_capacity = node->callees_capacity == 0 ? 4 : node->callees_capacity * 2;
+        node->callees = (int*)realloc(node->callees, sizeof(int) * node->callees_capacity);
+        if (node->callees == NULL) {
+            perror("CallGraph");
+            exit(3);
+        }
+    }
+    node->callees[node->callees_count++] = callee;
+}
+
+static void collect_calls(CallGraph* graph, SymbolTable* global, CallGraphNode* caller, Node* node) {
+    if (node == NULL) return;
+
+    if (node->label == function_call) {
+        int callee = call_graph_index(graph, global, FIRSTCHILD(node)->ident);
+        if (callee != -1) {
+            add_callee(caller, callee);
+            graph->nodes[callee].call_sites++;
+        }
+        else {
+            caller->calls_external = true;
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        collect_calls(graph, global, caller, child);
+    }
+}
+
+typedef struct {
+    int* index;
+    int* lowlink;
+    bool* on_stack;
+    int* stack;
+    int stack_size;
+    int counter;
+} Tarjan;
+
+// marks every function belonging to a cycle of the call graph
+static void strong_connect(CallGraph* graph, Tarjan* t, int v) {
+    t->index[v] = t->lowlink[v] = t->counter++;
+    t->stack[t->stack_size++] = v;
+    t->on_stack[v] = true;
+
+    CallGraphNode* node = &graph->nodes[v];
+    for (int i = 0; i < node->callees_count; i++) {
+        int w = node->callees[i];
+        if (w == v) {
+            node->recursive = true;
+        }
+
+        if (t->index[w] == -1) {
+            strong_connect(graph, t, w);
+            if (t->lowlink[w] < t->lowlink[v]) t->lowlink[v] = t->lowlink[w];
+        }
+        else if (t->on_stack[w] && t->index[w] < t->lowlink[v]) {
+            t->lowlink[v] = t->index[w];
+        }
+    }
+
+    if (t->lowlink[v] != t->index[v]) return;
+
+    // components are completed callees first
+    int first = t->stack_size;
+    int w;
+    do {
+        w = t->stack[--t->stack_size];
+        t->on_stack[w] = false;
+        graph->nodes[w].scc = graph->scc_count;
+    } while (w != v);
+    graph->scc_count++;
+
+    if (first - t->stack_size > 1) {
+        for (int i = t->stack_size; i < first; i++) {
+            graph->nodes[t->stack[i]].recursive = true;
+        }
+    }
+}
+
+CallGraph* new_call_graph(Node* functions, SymbolTable* global) {
+    CallGraph* graph = (CallGraph*)malloc(sizeof(CallGraph));
+    if (graph == NULL) {
+        perror("CallGraph");
+        exit(3);
+    }
+
+    graph->count = 0;
+    graph->scc_count = 0;
+    for (Node *func = functions->firstChild; func != NULL; func = func->nextSibling) {
+        graph->count++;
+    }
+
+    graph->nodes = (CallGraphNode*)calloc(graph->count > 0 ? graph->count : 1, sizeof(CallGraphNode));
+    if (graph->nodes == NULL) {
+        perror("CallGraph");
+        exit(3);
+    }
+
+    int i = 0;
+    for (Node *func = functions->firstChild; func != NULL; func = func->nextSibling, i++) {
+        Node* header = FIRSTCHILD(func);
+        graph->nodes[i].name = SECONDCHILD(header)->ident;
+        graph->nodes[i].function = func;
+        graph->nodes[i].size = count_nodes(SECONDCHILD(func));
+    }
+
+    for (i = 0; i < graph->count; i++) {
+        collect_calls(graph, global, &graph->nodes[i], SECONDCHILD(graph->nodes[i].function));
+    }
+
+    Tarjan t;
+    t.index = (int*)malloc(sizeof(int) * graph->count);
+    t.lowlink = (int*)malloc(sizeof(int) * graph->count);
+    t.on_stack = (bool*)calloc(graph->count, sizeof(bool));
+    t.stack = (int*)malloc(sizeof(int) * graph->count);
+    if (graph->count > 0 && (t.index == NULL || t.lowlink == NULL || t.on_stack == NULL || t.stack == NULL)) {
+        perror("CallGraph");
+        exit(3);
+    }
+    t.stack_size = 0;
+    t.counter = 0;
+
+    for (i = 0; i < graph->count; i++) t.index[i] = -1;
+    for (i = 0; i < graph->count; i++) {
+        if (t.index[i] == -1) strong_connect(graph, &t, i);
+    }
+
+    free(t.index);
+    free(t.lowlink);
+    free(t.on_stack);
+    free(t.stack);
+
+    return graph;
+}
+
+void free_call_graph(CallGraph* graph) {
+    for (int i = 0; i < graph->count; i++) {
+        free(graph->nodes[i].callees);
+        free(graph->nodes[i].calls);
+        free(graph->nodes[i].weights);
+    }
+    free(graph->nodes);
+    free(graph);
+}
+
+void call_graph_mark_reachable(CallGraph* graph, int root) {
+    CallGraphNode* node = &graph->nodes[root];
+    if (node->reachable) return;
+
+    node->reachable = true;
+    for (int i = 0; i < node->callees_count; i++) {
+        call_graph_mark_reachable(graph, node->callees[i]);
+    }
+}
+
+void call_graph_add_call(CallGraph* graph, int caller, int callee, int weight) {
+    CallGraphNode* node = &graph->nodes[caller];
+
+    for (int i = 0; i < node->calls_count; i++) {
+        if (node->calls[i] == callee) {
+            node->weights[i] += weight;
+            return;
+        }
+    }
+
+    if (node->calls_count == node->calls_capacity) {
+        node->calls_capacity = node->calls_capacity == 0 ? 4 : node->calls_capacity * 2;
+        node->calls = (int*)realloc(node->calls, sizeof(int) * node->calls_capacity);
+        node->weights = (int*)realloc(node->weights, sizeof(int) * node->calls_capacity);
+        if (node->calls == NULL || node->weights == NULL) {
+            perror("CallGraph");
+            exit(3);
+        }
+    }
+    node->calls[node->calls_count] = callee;
+    node->weights[node->calls_count] = weight;
+    node->calls_count++;
+}
+
+static void layout_from(CallGraph* graph, int v, bool* placed, int* order, int* count) {
+    placed[v] = true;
+    order[(*count)++] = v;
+
+    CallGraphNode* node = &graph->nodes[v];
+
+    // hottest callee first, so it lands right after its caller
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < node->calls_count; i++) {
+            if (placed[node->calls[i]]) continue;
+            if (best == -1 || node->weights[i] > node->weights[best]) best = i;
+        }
+        if (best == -1) break;
+
+        layout_from(graph, node->calls[best], placed, order, count);
+    }
+}
+
+// functions still called from root in the generated code, callers before their callees
+int call_graph_layout(CallGraph* graph, int root, int* order) {
+    bool* placed = (bool*)calloc(graph->count > 0 ? graph->count : 1, sizeof(bool));
+    if (placed == NULL) {
+        perror("CallGraph");
+        exit(3);
+    }
+
+    int count = 0;
+    layout_from(graph, root, placed, order, &count);
+
+    free(placed);
+    return count;
+}
+
+static bool declares(Node* declarations, char* ident) {
+    for (Node *type = declarations->firstChild; type != NULL; type = type->nextSibling) {
+        for (Node *var = type->firstChild; var != NULL; var = var->nextSibling) {
+            if (strcmp(var->ident, ident) == 0) return true;
+        }
+    }
+    return false;
+}
+
+static bool assigns_global(Node* node, Node* func) {
+    if (node == NULL) return false;
+
+    if (node->label == assignment) {
+        char* name = FIRSTCHILD(node)->ident;
+        Node* parameters = THIRDCHILD(FIRSTCHILD(func));
+        Node* declarations = FIRSTCHILD(SECONDCHILD(func));
+        if (!declares(parameters, name) && !declares(declarations, name)) return true;
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        if (assigns_global(child, func)) return true;
+    }
+    return false;
+}
+
+// builtins only read and write the standard streams
+void call_graph_mark_global_writers(CallGraph* graph) {
+    for (int i = 0; i < graph->count; i++) {
+        Node* func = graph->nodes[i].function;
+        graph->nodes[i].writes_globals = assigns_global(SECONDCHILD(SECONDCHILD(func)), func);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < graph->count; i++) {
+            CallGraphNode* node = &graph->nodes[i];
+            for (int j = 0; j < node->callees_count && !node->writes_globals; j++) {
+                if (graph->nodes[node->callees[j]].writes_globals) {
+                    node->writes_globals = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool call_graph_contains_call(Node* node) {
+    if (node == NULL) return false;
+    if (node->label == function_call) return true;
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        if (call_graph_contains_call(child)) return true;
+    }
+    return false;
+}
+
+// a call that may change a global, unknown functions are left to the checks that report them
+bool call_graph_contains_writer_call(CallGraph* graph, SymbolTable* global, Node* node) {
+    if (node == NULL) return false;
+    if (node->label == function_call) {
+        CallGraphNode* callee = call_graph_get(graph, global, FIRSTCHILD(node)->ident);
+        if (callee != NULL && callee->writes_globals) return true;
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        if (call_graph_contains_writer_call(graph, global, child)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#ifndef __CALLGRAPH__
+#define __CALLGRAPH__
+
+#include <stdbool.h>
+#include "tree.h"
+#include "SymbolTable.h"
+
+typedef struct {
+    char* name;
+    Node* function;
+    int size;           // number of nodes of the body
+    int call_sites;     // number of calls to this function in the whole program
+    int* callees;       // indexes of the called functions, one per call site
+    int callees_count;
+    int callees_capacity;
+    bool recursive;     // member of a call cycle
+    bool reachable;     // called directly or indirectly from main
+    int* calls;         // calls left in the generated code, after inlining
+    int* weights;       // estimated frequency of each of these calls
+    int calls_count;
+    int calls_capacity;
+    int scc;            // strongly connected component, callees are in lower ones
+    bool calls_external;// calls a builtin
+    bool leaf;          // compiled without frame, no call left in its code
+    bool custom;        // parameters arrive in registers below instead of the System V ones
+    int registers[6];   // register of each parameter, see Convention.h
+    unsigned int clobbers;  // registers a call to the function may modify
+    bool writes_globals;    // assigns a global, itself or through its callees
+} CallGraphNode;
+
+typedef struct {
+    CallGraphNode* nodes;
+    int count;
+    int scc_count;
+} CallGraph;
+
+CallGraph* new_call_graph(Node* functions, SymbolTable* global);
+void free_call_graph(CallGraph* graph);
+
+int call_graph_index(CallGraph* graph, SymbolTable* global, char* name);
+CallGraphNode* call_graph_get(CallGraph* graph, SymbolTable* global, char* name);
+
+int count_nodes(Node* node);
+
+void call_graph_mark_reachable(CallGraph* graph, int root);
+void call_graph_add_call(CallGraph* graph, int caller, int callee, int weight);
+int call_graph_layout(CallGraph* graph, int root, int* order);
+void call_graph_mark_global_writers(CallGraph* graph);
+bool call_graph_contains_call(Node* node);
+bool call_graph_contains_writer_call(CallGraph* graph, SymbolTable* global, Node* node);
+
+#endif
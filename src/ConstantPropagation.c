@@ -0,0 +1,475 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "ConstantPropagation.h"
+#include "ControlFlow.h"
+#include "utils.h"
+#include "stats.h"
+
+// what a variable holds where a block starts, UNDEFINED until a path reaching it is followed
+typedef enum {
+    UNDEFINED,
+    CONSTANT,   // value
+    COPY,       // the current value of the variable at index value
+    VARYING
+} LatticeKind;
+
+typedef struct {
+    LatticeKind kind;
+    int value;
+} Lattice;
+
+typedef struct {
+    ControlFlowGraph* cfg;
+    CallGraph* graph;
+    SymbolTable* global;
+    Lattice** in;           // state at the start of each block
+    bool* executable;       // reached by a branch that can be taken
+} Propagation;
+
+static Lattice varying = { VARYING, 0 };
+
+static Lattice constant(int value) {
+    Lattice lattice = { CONSTANT, value };
+    return lattice;
+}
+
+static Lattice meet(Lattice a, Lattice b) {
+    if (a.kind == UNDEFINED) return b;
+    if (b.kind == UNDEFINED) return a;
+    if (a.kind == b.kind && a.value == b.value) return a;
+    return varying;
+}
+
+static Lattice evaluate(Propagation* p, Node* e, Lattice* state) {
+    switch (e->label) {
+    case num:
+        return constant(e->num);
+
+    case character:
+        return constant(get_character_value(e->ident));
+
+    case ident: {
+        int i = cfg_variable_index(p->cfg, e->ident);
+        if (i == -1) return varying;
+        return state[i].kind == COPY ? varying : state[i];
+    }
+
+    case addsub:
+    case divstar:
+    case eq:
+    case order:
+    case not:
+    case and:
+    case or: {
+        Lattice a = evaluate(p, FIRSTCHILD(e), state);
+
+        // the first operand of && and || may decide alone
+        if (a.kind == CONSTANT && e->label == and && a.value == 0) return constant(0);
+        if (a.kind == CONSTANT && e->label == or && a.value != 0) return constant(1);
+
+        Lattice b = constant(0);
+        if (SECONDCHILD(e) != NULL) b = evaluate(p, SECONDCHILD(e), state);
+
+        if (a.kind == VARYING || b.kind == VARYING) return varying;
+        if (a.kind == UNDEFINED) return a;
+        if (b.kind == UNDEFINED) return b;
+
+        int value;
+        return fold_operation(e, a.value, b.value, &value) ? constant(value) : varying;
+    }
+
+    default:
+        return varying;
+    }
+}
+
+// the variables holding a copy of this one no longer do
+static void kill_copies(Propagation* p, Lattice* state, int variable) {
+    for (int i = 0; i < p->cfg->variables_count; i++) {
+        if (state[i].kind == COPY && state[i].value == variable) state[i] = varying;
+    }
+}
+
+static void kill_globals(Propagation* p, Lattice* state) {
+    for (int i = 0; i < p->cfg->variables_count; i++) {
+        if (!p->cfg->variables[i].global) continue;
+        state[i] = varying;
+        kill_copies(p, state, i);
+    }
+}
+
+static Lattice get_assigned_value(Propagation* p, int target, Node* e, Lattice* state) {
+    Variable* variable = &p->cfg->variables[target];
+
+    int source = e->label == ident ? cfg_variable_index(p->cfg, e->ident) : -1;
+    if (source != -1 && state[source].kind != CONSTANT) {
+        if (state[source].kind == UNDEFINED) return state[source];
+        if (p->cfg->variables[source].integer != variable->integer) return varying;
+        return state[source].kind == COPY ? state[source] : (Lattice){ COPY, source };
+    }
+
+    // a char only keeps the values every representation of it reads back the same
+    Lattice value = evaluate(p, e, state);
+    if (value.kind == CONSTANT && !variable->integer && (value.value < 0 || value.value > 127)) return varying;
+    return value;
+}
+
+static void transfer(Propagation* p, Node* instr, Lattice* state) {
+    switch (instr->label) {
+    case assignment: {
+        int target = cfg_variable_index(p->cfg, FIRSTCHILD(instr)->ident);
+        Lattice value = target != -1 ? get_assigned_value(p, target, SECONDCHILD(instr), state) : varying;
+
+        if (call_graph_contains_writer_call(p->graph, p->global, SECONDCHILD(instr))) kill_globals(p, state);
+        if (target == -1) return;
+
+        // assigned the value it already holds
+        if (value.kind == COPY && value.value == target) return;
+
+        state[target] = value;
+        kill_copies(p, state, target);
+        break;
+    }
+
+    case function_call:
+        if (call_graph_contains_writer_call(p->graph, p->global, instr)) kill_globals(p, state);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void copy_state(Propagation* p, Lattice* to, Lattice* from) {
+    memcpy(to, from, sizeof(Lattice) * p->cfg->variables_count);
+}
+
+// the state of the successor takes the values of one more path, true if it changed
+static bool merge(Propagation* p, int block, Lattice* state) {
+    bool changed = !p->executable[block];
+    p->executable[block] = true;
+
+    Lattice* in = p->in[block];
+    for (int i = 0; i < p->cfg->variables_count; i++) {
+        Lattice value = meet(in[i], state[i]);
+        if (value.kind != in[i].kind || value.value != in[i].value) {
+            in[i] = value;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// successors of the block a branch can take, -1 for all of them
+static int get_taken_successor(Propagation* p, BasicBlock* block, Lattice* state, bool* none) {
+    *none = false;
+    if (block->branch == NULL || block->branch->label == switch_) return -1;
+
+    Lattice condition = evaluate(p, FIRSTCHILD(block->branch), state);
+    if (condition.kind == UNDEFINED) {
+        *none = true;
+        return -1;
+    }
+    if (condition.kind == CONSTANT) return condition.value != 0 ? 0 : 1;
+    return -1;
+}
+
+static void analyze(Propagation* p, Lattice* entry) {
+    ControlFlowGraph* cfg = p->cfg;
+    int* worklist = (int*)malloc(sizeof(int) * cfg->count);
+    bool* queued = (bool*)calloc(cfg->count, sizeof(bool));
+    Lattice* state = (Lattice*)malloc(sizeof(Lattice) * (cfg->variables_count > 0 ? cfg->variables_count : 1));
+    if (worklist == NULL || queued == NULL || state == NULL) {
+        perror("ConstantPropagation");
+        exit(3);
+    }
+
+    merge(p, CFG_ENTRY, entry);
+    int count = 0;
+    worklist[count++] = CFG_ENTRY;
+    queued[CFG_ENTRY] = true;
+
+    while (count > 0) {
+        int b = worklist[--count];
+        queued[b] = false;
+        BasicBlock* block = &cfg->blocks[b];
+
+        copy_state(p, state, p->in[b]);
+        for (int i = 0; i < block->statements_count; i++) {
+            transfer(p, block->statements[i], state);
+        }
+
+        bool none;
+        int taken = get_taken_successor(p, block, state, &none);
+        if (none) continue;
+        if (block->branch != NULL && call_graph_contains_writer_call(p->graph, p->global, FIRSTCHILD(block->branch))) kill_globals(p, state);
+
+        for (int i = 0; i < block->successors_count; i++) {
+            if (taken != -1 && i != taken) continue;
+
+            int successor = block->successors[i];
+            if (merge(p, successor, state) && !queued[successor]) {
+                worklist[count++] = successor;
+                queued[successor] = true;
+            }
+        }
+    }
+
+    free(worklist);
+    free(queued);
+    free(state);
+}
+
+// a char constant is written as a character to keep the type of the expression
+static Node* make_constant(Variable* variable, int value) {
+    if (variable->integer) {
+        Node* node = makeNode(num);
+        node->num = value;
+        return node;
+    }
+
+    Node* node = makeNode(character);
+    if (value == '\n') strcpy(node->ident, "'\\n'");
+    else if (value == '\t') strcpy(node->ident, "'\\t'");
+    else if (value == '\'' || value == '\\') sprintf(node->ident, "'\\%c'", value);
+    else sprintf(node->ident, "'%c'", value);
+    return node;
+}
+
+static bool is_printable(int value) {
+    return value == '\n' || value == '\t' || (value >= ' ' && value <= '~');
+}
+
+// globals are kept when a call of the expression may change them before they are read
+static void substitute(Propagation* p, Node** link, Lattice* state, bool globals) {
+    Node* e = *link;
+
+    if (e->label == function_call) {
+        Node* arguments = SECONDCHILD(e);
+        if (arguments == NULL) return;
+        for (Node **child = &arguments->firstChild; *child != NULL; child = &(*child)->nextSibling) {
+            substitute(p, child, state, globals);
+        }
+        return;
+    }
+
+    if (e->label == ident) {
+        int i = cfg_variable_index(p->cfg, e->ident);
+        if (i == -1) return;
+
+        Variable* variable = &p->cfg->variables[i];
+        if (variable->global && !globals) return;
+
+        if (state[i].kind == CONSTANT && (variable->integer || is_printable(state[i].value))) {
+            Node* replacement = make_constant(variable, state[i].value);
+            replacement->lineno = e->lineno;
+            replacement->nextSibling = e->nextSibling;
+            *link = replacement;
+
+            e->nextSibling = NULL;
+            deleteTree(e);
+            stats.propagated_values++;
+        }
+        else if (state[i].kind == COPY && (globals || !p->cfg->variables[state[i].value].global)) {
+            strcpy(e->ident, p->cfg->variables[state[i].value].name);
+            stats.propagated_values++;
+        }
+        return;
+    }
+
+    for (Node **child = &e->firstChild; *child != NULL; child = &(*child)->nextSibling) {
+        substitute(p, child, state, globals);
+    }
+}
+
+static void rewrite_statement(Propagation* p, Node* instr, Lattice* state) {
+    bool globals = !call_graph_contains_writer_call(p->graph, p->global, instr);
+
+    switch (instr->label) {
+    case assignment:
+        substitute(p, &FIRSTCHILD(instr)->nextSibling, state, globals);
+        break;
+
+    case function_call:
+        substitute(p, &instr, state, globals);
+        break;
+
+    case return_:
+        if (instr->firstChild != NULL) substitute(p, &instr->firstChild, state, globals);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void rewrite(Propagation* p) {
+    ControlFlowGraph* cfg = p->cfg;
+    Lattice* state = (Lattice*)malloc(sizeof(Lattice) * (cfg->variables_count > 0 ? cfg->variables_count : 1));
+    if (state == NULL) {
+        perror("ConstantPropagation");
+        exit(3);
+    }
+
+    // blocks no branch reaches are left to the code generator, which checks them
+    for (int b = 0; b < cfg->count; b++) {
+        if (!p->executable[b]) continue;
+        BasicBlock* block = &cfg->blocks[b];
+
+        copy_state(p, state, p->in[b]);
+        for (int i = 0; i < block->statements_count; i++) {
+            rewrite_statement(p, block->statements[i], state);
+            transfer(p, block->statements[i], state);
+        }
+
+        if (block->branch != NULL) {
+            Node* condition = FIRSTCHILD(block->branch);
+            substitute(p, &block->branch->firstChild, state, !call_graph_contains_writer_call(p->graph, p->global, condition));
+        }
+    }
+
+    free(state);
+}
+
+static void propagate_function(CallGraph* graph, SymbolTable* global, Node* func, int* parameters, bool* known) {
+    Propagation p;
+    p.cfg = new_control_flow_graph(func, global);
+    p.graph = graph;
+    p.global = global;
+
+    ControlFlowGraph* cfg = p.cfg;
+    int size = cfg->variables_count > 0 ? cfg->variables_count : 1;
+    p.in = (Lattice**)malloc(sizeof(Lattice*) * cfg->count);
+    p.executable = (bool*)calloc(cfg->count, sizeof(bool));
+    Lattice* entry = (Lattice*)malloc(sizeof(Lattice) * size);
+    if (p.in == NULL || p.executable == NULL || entry == NULL) {
+        perror("ConstantPropagation");
+        exit(3);
+    }
+    for (int b = 0; b < cfg->count; b++) {
+        p.in[b] = (Lattice*)calloc(size, sizeof(Lattice));
+        if (p.in[b] == NULL) {
+            perror("ConstantPropagation");
+            exit(3);
+        }
+    }
+
+    // locals are not initialized, parameters are unknown unless every call agrees
+    for (int i = 0; i < cfg->variables_count; i++) {
+        entry[i] = varying;
+    }
+    int k = 0;
+    for (Node *type = THIRDCHILD(FIRSTCHILD(func))->firstChild; type != NULL; type = type->nextSibling, k++) {
+        int i = cfg_variable_index(cfg, FIRSTCHILD(type)->ident);
+        if (i == -1 || !known[k]) continue;
+        if (!cfg->variables[i].integer && (parameters[k] < 0 || parameters[k] > 127)) continue;
+        entry[i] = constant(parameters[k]);
+    }
+
+    analyze(&p, entry);
+    rewrite(&p);
+
+    for (int b = 0; b < cfg->count; b++) {
+        free(p.in[b]);
+    }
+    free(p.in);
+    free(p.executable);
+    free(entry);
+    free_control_flow_graph(cfg);
+}
+
+static int count_parameters(Node* func) {
+    int count = 0;
+    for (Node *type = THIRDCHILD(FIRSTCHILD(func))->firstChild; type != NULL; type = type->nextSibling) {
+        count++;
+    }
+    return count;
+}
+
+// meets the constant arguments of the calls found under the node into the ones of their callees,
+// only the calls to callee if it is not -1, else only the calls leaving the component scc
+static void collect_arguments(CallGraph* graph, SymbolTable* global, Node* node, int callee, int scc, Lattice (*arguments)[MAX_ARGS], int* counts) {
+    if (node == NULL) return;
+
+    int c = node->label == function_call ? call_graph_index(graph, global, FIRSTCHILD(node)->ident) : -1;
+    if (c != -1 && (callee != -1 ? c == callee : graph->nodes[c].scc != scc)) {
+        Node* argument = SECONDCHILD(node) != NULL ? SECONDCHILD(node)->firstChild : NULL;
+        for (int k = 0; k < counts[c]; k++) {
+            int value;
+            arguments[c][k] = meet(arguments[c][k], argument != NULL && get_constant_value(argument, &value) ? constant(value) : varying);
+            if (argument != NULL) argument = argument->nextSibling;
+        }
+        // the semantic error is reported when the call is compiled
+        if (argument != NULL) {
+            for (int k = 0; k < counts[c]; k++) {
+                arguments[c][k] = varying;
+            }
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        collect_arguments(graph, global, child, callee, scc, arguments, counts);
+    }
+}
+
+void propagate_constants(CallGraph* graph, SymbolTable* global) {
+    int size = graph->count > 0 ? graph->count : 1;
+    int* order = (int*)malloc(sizeof(int) * size);
+    int* counts = (int*)malloc(sizeof(int) * size);
+    Lattice (*arguments)[MAX_ARGS] = (Lattice (*)[MAX_ARGS])malloc(sizeof(*arguments) * size);
+    int* start = (int*)calloc(graph->scc_count + 1, sizeof(int));
+    if (order == NULL || counts == NULL || arguments == NULL || start == NULL) {
+        perror("ConstantPropagation");
+        exit(3);
+    }
+
+    // callers are in higher components than their callees, a counting sort puts them first
+    for (int i = 0; i < graph->count; i++) {
+        counts[i] = count_parameters(graph->nodes[i].function);
+        for (int k = 0; k < counts[i]; k++) {
+            arguments[i][k].kind = UNDEFINED;
+        }
+        if (graph->nodes[i].reachable) start[graph->scc_count - graph->nodes[i].scc]++;
+    }
+    for (int k = 0; k < graph->scc_count; k++) {
+        start[k + 1] += start[k];
+    }
+    int count = start[graph->scc_count];
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].reachable) order[start[graph->scc_count - 1 - graph->nodes[i].scc]++] = i;
+    }
+
+    // every caller in a higher component already met the arguments it passes once rewritten,
+    // the callers in the same one are walked again for each of its functions
+    for (int first = 0; first < count;) {
+        int scc = graph->nodes[order[first]].scc;
+        int last = first;
+        while (last < count && graph->nodes[order[last]].scc == scc) last++;
+
+        for (int n = first; n < last; n++) {
+            int parameters[MAX_ARGS];
+            bool known[MAX_ARGS];
+            for (int i = first; i < last; i++) {
+                collect_arguments(graph, global, SECONDCHILD(graph->nodes[order[i]].function), order[n], scc, arguments, counts);
+            }
+            for (int k = 0; k < counts[order[n]]; k++) {
+                known[k] = arguments[order[n]][k].kind == CONSTANT;
+                parameters[k] = arguments[order[n]][k].value;
+            }
+
+            propagate_function(graph, global, graph->nodes[order[n]].function, parameters, known);
+        }
+        for (int n = first; n < last; n++) {
+            collect_arguments(graph, global, SECONDCHILD(graph->nodes[order[n]].function), -1, scc, arguments, counts);
+        }
+        first = last;
+    }
+
+    free(start);
+    free(arguments);
+    free(counts);
+    free(order);
+}
@@ -0,0 +1,13 @@
+#ifndef __CONSTANT_PROPAGATION__
+#define __CONSTANT_PROPAGATION__
+
+#include "tree.h"
+#include "SymbolTable.h"
+#include "CallGraph.h"
+
+// replaces the reads of variables holding a known constant, or the value of another
+// variable, along the branches that can be taken; callers go first so that a parameter
+// every call passes the same constant to becomes a constant of the callee
+void propagate_constants(CallGraph* graph, SymbolTable* global);
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "ControlFlow.h"
+
+static void* grow(void* array, int* capacity, int count, size_t size) {
+    if (count < *capacity) return array;
+
+    *capacity = *capacity == 0 ? 4 : *capacity * 2;
+    array = realloc(array, size * *capacity);
+    if (array == NULL) {
+        perror("ControlFlow");
+        exit(3);
+    }
+    return array;
+}
+
+static int new_block(ControlFlowGraph* cfg) {
+    cfg->blocks = (BasicBlock*)grow(cfg->blocks, &cfg->capacity, cfg->count, sizeof(BasicBlock));
+    memset(&cfg->blocks[cfg->count], 0, sizeof(BasicBlock));
+    return cfg->count++;
+}
+
+static void add_edge(ControlFlowGraph* cfg, int from, int to) {
+    BasicBlock* source = &cfg->blocks[from];
+    source->successors = (int*)grow(source->successors, &source->successors_capacity, source->successors_count, sizeof(int));
+    source->successors[source->successors_count++] = to;
+
+    BasicBlock* target = &cfg->blocks[to];
+    target->predecessors = (int*)grow(target->predecessors, &target->predecessors_capacity, target->predecessors_count, sizeof(int));
+    target->predecessors[target->predecessors_count++] = from;
+}
+
+static void add_statement(ControlFlowGraph* cfg, int block, Node* instr) {
+    BasicBlock* b = &cfg->blocks[block];
+    b->statements = (Node**)grow(b->statements, &b->statements_capacity, b->statements_count, sizeof(Node*));
+    b->statements[b->statements_count++] = instr;
+}
+
+static int build_statements(ControlFlowGraph* cfg, Node* first, int current, int after_switch);
+
+// returns the block where the code following the statement starts
+static int build_statement(ControlFlowGraph* cfg, Node* instr, int current, int after_switch) {
+    switch (instr->label) {
+    case assignment:
+    case function_call:
+        add_statement(cfg, current, instr);
+        return current;
+
+    case return_:
+        add_statement(cfg, current, instr);
+        add_edge(cfg, current, CFG_EXIT);
+        return new_block(cfg);
+
+    case break_:
+        if (after_switch != -1) add_edge(cfg, current, after_switch);
+        return new_block(cfg);
+
+    case body:
+        return build_statements(cfg, instr->firstChild, current, after_switch);
+
+    case if_: {
+        Node* then_instr = SECONDCHILD(instr);
+        Node* else_instr = NULL;
+        if (then_instr != NULL && then_instr->label == else_) {
+            else_instr = FIRSTCHILD(then_instr);
+            then_instr = NULL;
+        }
+        else if (then_instr != NULL && then_instr->nextSibling != NULL) {
+            else_instr = FIRSTCHILD(then_instr->nextSibling);
+        }
+
+        cfg->blocks[current].branch = instr;
+        int then_entry = new_block(cfg);
+        int else_entry = new_block(cfg);
+        add_edge(cfg, current, then_entry);
+        add_edge(cfg, current, else_entry);
+
+        int then_end = then_instr != NULL ? build_statement(cfg, then_instr, then_entry, after_switch) : then_entry;
+        int else_end = else_instr != NULL ? build_statement(cfg, else_instr, else_entry, after_switch) : else_entry;
+
+        int join = new_block(cfg);
+        add_edge(cfg, then_end, join);
+        add_edge(cfg, else_end, join);
+        return join;
+    }
+
+    case while_: {
+        int header = new_block(cfg);
+        add_edge(cfg, current, header);
+        cfg->blocks[header].branch = instr;
+
+        int body_entry = new_block(cfg);
+        int after = new_block(cfg);
+        add_edge(cfg, header, body_entry);
+        add_edge(cfg, header, after);
+
+        Node* loop_body = SECONDCHILD(instr);
+        int body_end = loop_body != NULL ? build_statement(cfg, loop_body, body_entry, after_switch) : body_entry;
+        add_edge(cfg, body_end, header);
+        return after;
+    }
+
+    case switch_: {
+        // a case may fall into the next one or leave the switch at its end
+        cfg->blocks[current].branch = instr;
+        int after = new_block(cfg);
+
+        bool has_default = false;
+        int previous_end = -1;
+        for (Node *node = SECONDCHILD(instr)->firstChild; node != NULL; node = node->nextSibling) {
+            int entry = new_block(cfg);
+            add_edge(cfg, current, entry);
+            if (previous_end != -1) add_edge(cfg, previous_end, entry);
+
+            Node* case_body = node->label == case_ ? SECONDCHILD(node) : FIRSTCHILD(node);
+            has_default |= node->label == default_;
+
+            previous_end = build_statements(cfg, case_body->firstChild, entry, after);
+            add_edge(cfg, previous_end, after);
+        }
+        if (!has_default) add_edge(cfg, current, after);
+        return after;
+    }
+
+    default:
+        return current;
+    }
+}
+
+static int build_statements(ControlFlowGraph* cfg, Node* first, int current, int after_switch) {
+    for (Node *instr = first; instr != NULL; instr = instr->nextSibling) {
+        current = build_statement(cfg, instr, current, after_switch);
+    }
+    return current;
+}
+
+// type of the variable declared with the name, NULL if there is none
+static Node* declares(Node* declarations, char* ident) {
+    for (Node *type = declarations->firstChild; type != NULL; type = type->nextSibling) {
+        for (Node *var = type->firstChild; var != NULL; var = var->nextSibling) {
+            if (strcmp(var->ident, ident) == 0) return type;
+        }
+    }
+    return NULL;
+}
+
+static unsigned int name_hash(char* name) {
+    unsigned int hash = 5381;
+    for (; *name != '\0'; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash;
+}
+
+// slot of the name, or the free slot where it would go
+static int find_slot(ControlFlowGraph* cfg, char* name) {
+    int mask = cfg->slots_count - 1;
+    int s = name_hash(name) & mask;
+    while (cfg->slots[s] != -1 && strcmp(cfg->variables[cfg->slots[s]].name, name) != 0) {
+        s = (s + 1) & mask;
+    }
+    return s;
+}
+
+int cfg_variable_index(ControlFlowGraph* cfg, char* name) {
+    if (cfg->slots_count == 0) return -1;
+    return cfg->slots[find_slot(cfg, name)];
+}
+
+static void add_slot(ControlFlowGraph* cfg, int index) {
+    if (2 * (index + 1) > cfg->slots_count) {
+        free(cfg->slots);
+        cfg->slots_count = cfg->slots_count == 0 ? 16 : cfg->slots_count * 2;
+        cfg->slots = (int*)malloc(sizeof(int) * cfg->slots_count);
+        if (cfg->slots == NULL) {
+            perror("ControlFlow");
+            exit(3);
+        }
+        memset(cfg->slots, -1, sizeof(int) * cfg->slots_count);
+        for (int i = 0; i < index; i++) {
+            cfg->slots[find_slot(cfg, cfg->variables[i].name)] = i;
+        }
+    }
+    cfg->slots[find_slot(cfg, cfg->variables[index].name)] = index;
+}
+
+static void collect_variables(ControlFlowGraph* cfg, SymbolTable* global, Node* node, int* capacity) {
+    if (node == NULL) return;
+
+    if (node->label == function_call) {
+        collect_variables(cfg, global, SECONDCHILD(node), capacity);
+        return;
+    }
+
+    if (node->label == ident && cfg_variable_index(cfg, node->ident) == -1) {
+        Node* type = declares(THIRDCHILD(FIRSTCHILD(cfg->function)), node->ident);
+        if (type == NULL) type = declares(FIRSTCHILD(SECONDCHILD(cfg->function)), node->ident);
+
+        bool is_global = type == NULL && table_contains(global, node->ident) && table_get_type(global, node->ident).type == TYPE_PRIMITIF;
+        if (type != NULL || is_global) {
+            cfg->variables = (Variable*)grow(cfg->variables, capacity, cfg->variables_count, sizeof(Variable));
+            Variable* variable = &cfg->variables[cfg->variables_count++];
+            strcpy(variable->name, node->ident);
+            variable->global = is_global;
+            variable->integer = is_global ? table_get_type(global, node->ident).primitif == TYPE_INT : strcmp(type->ident, "int") == 0;
+            add_slot(cfg, cfg->variables_count - 1);
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        collect_variables(cfg, global, child, capacity);
+    }
+}
+
+ControlFlowGraph* new_control_flow_graph(Node* func, SymbolTable* global) {
+    ControlFlowGraph* cfg = (ControlFlowGraph*)calloc(1, sizeof(ControlFlowGraph));
+    if (cfg == NULL) {
+        perror("ControlFlow");
+        exit(3);
+    }
+    cfg->function = func;
+
+    new_block(cfg);
+    new_block(cfg);
+
+    Node* instructions = SECONDCHILD(SECONDCHILD(func));
+    int end = build_statements(cfg, instructions->firstChild, CFG_ENTRY, -1);
+    add_edge(cfg, end, CFG_EXIT);
+
+    int capacity = 0;
+    collect_variables(cfg, global, instructions, &capacity);
+    return cfg;
+}
+
+void free_control_flow_graph(ControlFlowGraph* cfg) {
+    for (int i = 0; i < cfg->count; i++) {
+        free(cfg->blocks[i].statements);
+        free(cfg->blocks[i].successors);
+        free(cfg->blocks[i].predecessors);
+    }
+    free(cfg->blocks);
+    free(cfg->variables);
+    free(cfg->slots);
+    free(cfg);
+}
@@ -0,0 +1,46 @@
+#ifndef __CONTROLFLOW__
+#define __CONTROLFLOW__
+
+#include <stdbool.h>
+#include "tree.h"
+#include "SymbolTable.h"
+
+#define CFG_ENTRY 0
+#define CFG_EXIT 1
+
+typedef struct {
+    Node** statements;      // assignments, calls and returns, run in order
+    int statements_count;
+    int statements_capacity;
+    Node* branch;           // if_, while_ or switch_ whose expression ends the block, NULL if none
+    int* successors;        // of a branch: when true then when false, or every case then after the switch
+    int successors_count;
+    int successors_capacity;
+    int* predecessors;
+    int predecessors_count;
+    int predecessors_capacity;
+} BasicBlock;
+
+typedef struct {
+    char name[64];
+    bool global;
+    bool integer;           // int, a char keeps only its low byte
+} Variable;
+
+typedef struct {
+    Node* function;
+    BasicBlock* blocks;
+    int count;
+    int capacity;
+    Variable* variables;    // every primitive variable the body reads or writes
+    int variables_count;
+    int* slots;             // open addressing table of the variable indices by name, -1 when free
+    int slots_count;        // a power of two at least twice variables_count
+} ControlFlowGraph;
+
+ControlFlowGraph* new_control_flow_graph(Node* func, SymbolTable* global);
+void free_control_flow_graph(ControlFlowGraph* cfg);
+
+int cfg_variable_index(ControlFlowGraph* cfg, char* name);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Convention.h"
+
+static char* names[REGISTERS_COUNT][2] = {
+    {"eax", "rax"}, {"ebx", "rbx"}, {"ecx", "rcx"}, {"edx", "rdx"},
+    {"esi", "rsi"}, {"edi", "rdi"}, {"r8d", "r8"}, {"r9d", "r9"},
+    {"r10d", "r10"}, {"r11d", "r11"}, {"r12d", "r12"}, {"r13d", "r13"},
+    {"r14d", "r14"}, {"r15d", "r15"},
+};
+
+static char* byte_names[REGISTERS_COUNT] = {
+    "al", "bl", "cl", "dl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+
+const int system_v_registers[6] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+// rdx and rcx are scratch registers of the expressions, a leaf keeps its parameters elsewhere;
+// the third and fourth ones take r10 and r11 from the intermediate results
+const int leaf_registers[6] = {REG_RDI, REG_RSI, REG_R10, REG_R11, REG_R8, REG_R9};
+
+// parameters living across calls, callee-saved ones first since the builtins keep them
+static const int saved_registers[] = {
+    REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15, REG_RSI, REG_RDI, REG_R8, REG_R9, REG_R10, REG_R11,
+};
+
+// expressions compute in rax, rcx and rdx and hold intermediate results in r10 and r11
+#define SCRATCH (REGISTER_BIT(REG_RAX) | REGISTER_BIT(REG_RCX) | REGISTER_BIT(REG_RDX) \
+    | REGISTER_BIT(REG_R10) | REGISTER_BIT(REG_R11))
+#define CALLER_SAVED (SCRATCH | REGISTER_BIT(REG_RSI) | REGISTER_BIT(REG_RDI) | REGISTER_BIT(REG_R8) \
+    | REGISTER_BIT(REG_R9))
+
+char* register_name(int reg, bool wide) {
+    return names[reg][wide ? 1 : 0];
+}
+
+// low byte, what a char is stored from
+char* byte_register_name(int reg) {
+    return byte_names[reg];
+}
+
+// register of a name of either width, -1 for a memory operand
+int register_from_name(char* name) {
+    for (int reg = 0; reg < REGISTERS_COUNT; reg++) {
+        if (strcmp(names[reg][0], name) == 0 || strcmp(names[reg][1], name) == 0) return reg;
+    }
+    return -1;
+}
+
+// registers receiving the arguments of a call to the function, builtins follow System V
+const int* parameter_registers_of(CallGraphNode* node) {
+    if (node != NULL && node->custom) return node->registers;
+    return system_v_registers;
+}
+
+static int count_parameters(CallGraphNode* node) {
+    Node* parameters = THIRDCHILD(FIRSTCHILD(node->function));
+
+    int count = 0;
+    for (Node *child = parameters->firstChild; child != NULL; child = child->nextSibling) {
+        count++;
+    }
+    return count;
+}
+
+// System V registers written by the caller to pass the arguments
+static unsigned int system_v_parameters(int count) {
+    unsigned int set = 0;
+    for (int j = 0; j < count && j < 6; j++) {
+        set |= REGISTER_BIT(system_v_registers[j]);
+    }
+    return set;
+}
+
+// a leaf keeps its parameters in the registers it does not use, any other function
+// needs registers that none of its callees modify
+static void choose_registers(CallGraphNode* node, int parameters, unsigned int callees) {
+    if (node->leaf) {
+        for (int j = 0; j < parameters; j++) {
+            node->registers[j] = leaf_registers[j];
+        }
+        node->custom = true;
+        return;
+    }
+
+    int j = 0;
+    int count = (int)(sizeof(saved_registers) / sizeof(saved_registers[0]));
+    for (int i = 0; i < count && j < parameters; i++) {
+        if (callees & REGISTER_BIT(saved_registers[i])) continue;
+        node->registers[j++] = saved_registers[i];
+    }
+    node->custom = j == parameters;
+}
+
+void assign_conventions(CallGraph* graph, bool custom) {
+    int* order = (int*)malloc(sizeof(int) * (graph->count > 0 ? graph->count : 1));
+    int* start = (int*)calloc(graph->scc_count + 1, sizeof(int));
+    if (order == NULL || start == NULL) {
+        perror("assign_conventions");
+        exit(3);
+    }
+
+    // Tarjan numbers the components callees first, a counting sort keeps that order
+    for (int i = 0; i < graph->count; i++) {
+        start[graph->nodes[i].scc + 1]++;
+    }
+    for (int k = 0; k < graph->scc_count; k++) {
+        start[k + 1] += start[k];
+    }
+    int* fill = (int*)malloc(sizeof(int) * (graph->scc_count > 0 ? graph->scc_count : 1));
+    if (fill == NULL) {
+        perror("assign_conventions");
+        exit(3);
+    }
+    for (int k = 0; k < graph->scc_count; k++) {
+        fill[k] = start[k];
+    }
+    for (int i = 0; i < graph->count; i++) {
+        order[fill[graph->nodes[i].scc]++] = i;
+    }
+    free(fill);
+
+    for (int k = 0; k < graph->scc_count; k++) {
+        unsigned int callees = 0;
+        unsigned int own = SCRATCH;
+
+        for (int m = start[k]; m < start[k + 1]; m++) {
+            CallGraphNode* node = &graph->nodes[order[m]];
+            for (int i = 0; i < node->callees_count; i++) {
+                CallGraphNode* callee = &graph->nodes[node->callees[i]];
+                if (callee->scc != k) callees |= callee->clobbers;
+            }
+            if (node->calls_external) callees |= CALLER_SAVED;
+        }
+
+        // a cycle of calls keeps the standard convention, parameters are spilled anyway
+        CallGraphNode* first = &graph->nodes[order[start[k]]];
+        bool cycle = start[k + 1] - start[k] > 1 || (first->recursive && !first->leaf);
+
+        for (int m = start[k]; m < start[k + 1]; m++) {
+            CallGraphNode* node = &graph->nodes[order[m]];
+            int parameters = count_parameters(node);
+
+            node->custom = false;
+            if (custom && !cycle && node->reachable && parameters <= 6 && strcmp(node->name, "main") != 0) {
+                choose_registers(node, parameters, callees);
+            }
+
+            if (node->custom) {
+                for (int j = 0; j < parameters; j++) {
+                    own |= REGISTER_BIT(node->registers[j]);
+                }
+            }
+            else {
+                own |= system_v_parameters(parameters);
+            }
+
+            // a leaf following System V moves its parameters to the leaf registers
+            if (node->leaf) {
+                for (int j = 0; j < parameters; j++) {
+                    own |= REGISTER_BIT(leaf_registers[j]);
+                }
+            }
+        }
+
+        for (int m = start[k]; m < start[k + 1]; m++) {
+            graph->nodes[order[m]].clobbers = own | callees;
+        }
+    }
+
+    free(order);
+    free(start);
+}
@@ -0,0 +1,24 @@
+#ifndef __CONVENTION__
+#define __CONVENTION__
+
+#include <stdbool.h>
+#include "CallGraph.h"
+
+enum {
+    REG_RAX, REG_RBX, REG_RCX, REG_RDX, REG_RSI, REG_RDI, REG_R8, REG_R9,
+    REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15, REGISTERS_COUNT
+};
+
+#define REGISTER_BIT(reg) (1u << (reg))
+
+extern const int system_v_registers[6];
+extern const int leaf_registers[6];
+
+char* register_name(int reg, bool wide);
+char* byte_register_name(int reg);
+int register_from_name(char* name);
+const int* parameter_registers_of(CallGraphNode* node);
+
+void assign_conventions(CallGraph* graph, bool custom);
+
+#endif
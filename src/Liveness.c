@@ -0,0 +1,387 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "Liveness.h"
+#include "ControlFlow.h"
+#include "CallGraph.h"
+#include "utils.h"
+#include "stats.h"
+
+// sets of locals, one bit each; globals are never removed nor given a slot, they are not tracked
+typedef unsigned long Word;
+
+#define WORD_BITS ((int)(8 * sizeof(Word)))
+
+typedef struct {
+    ControlFlowGraph* cfg;
+    int* local;             // bit of each variable of the graph, -1 for a global
+    int locals_count;
+    int words;              // of a set
+    Word** live_in;         // locals read before being assigned from the start of each block
+    Word** live_out;
+} Liveness;
+
+static Word* new_set(Liveness* l) {
+    Word* set = (Word*)calloc(l->words > 0 ? l->words : 1, sizeof(Word));
+    if (set == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+    return set;
+}
+
+static bool is_live(Word* set, int bit) {
+    return bit != -1 && (set[bit / WORD_BITS] >> (bit % WORD_BITS) & 1) != 0;
+}
+
+static void set_live(Word* set, int bit, bool live) {
+    if (bit == -1) return;
+    if (live) set[bit / WORD_BITS] |= (Word)1 << (bit % WORD_BITS);
+    else set[bit / WORD_BITS] &= ~((Word)1 << (bit % WORD_BITS));
+}
+
+// bit of the local with the name, -1 for a global or anything else
+static int get_local(Liveness* l, char* name) {
+    int i = cfg_variable_index(l->cfg, name);
+    return i != -1 ? l->local[i] : -1;
+}
+
+static void add_uses(Liveness* l, Node* node, Word* live) {
+    if (node == NULL) return;
+
+    if (node->label == function_call) {
+        add_uses(l, SECONDCHILD(node), live);
+        return;
+    }
+    if (node->label == ident) {
+        set_live(live, get_local(l, node->ident), true);
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        add_uses(l, child, live);
+    }
+}
+
+// from the locals live after the statement to those live before it
+static void transfer(Liveness* l, Node* instr, Word* live) {
+    switch (instr->label) {
+    case assignment:
+        set_live(live, get_local(l, FIRSTCHILD(instr)->ident), false);
+        add_uses(l, SECONDCHILD(instr), live);
+        break;
+
+    case function_call:
+    case return_:
+        add_uses(l, instr, live);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// the condition ending the block is read after its statements
+static void get_block_end(Liveness* l, int b, Word* live) {
+    BasicBlock* block = &l->cfg->blocks[b];
+    memcpy(live, l->live_out[b], sizeof(Word) * l->words);
+    if (block->branch != NULL) add_uses(l, FIRSTCHILD(block->branch), live);
+}
+
+static Liveness* new_liveness(Node* func, SymbolTable* global) {
+    Liveness* l = (Liveness*)malloc(sizeof(Liveness));
+    if (l == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+    l->cfg = new_control_flow_graph(func, global);
+
+    ControlFlowGraph* cfg = l->cfg;
+    l->local = (int*)malloc(sizeof(int) * (cfg->variables_count > 0 ? cfg->variables_count : 1));
+    l->live_in = (Word**)malloc(sizeof(Word*) * cfg->count);
+    l->live_out = (Word**)malloc(sizeof(Word*) * cfg->count);
+    if (l->local == NULL || l->live_in == NULL || l->live_out == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+    l->locals_count = 0;
+    for (int i = 0; i < cfg->variables_count; i++) {
+        l->local[i] = cfg->variables[i].global ? -1 : l->locals_count++;
+    }
+    l->words = (l->locals_count + WORD_BITS - 1) / WORD_BITS;
+    for (int b = 0; b < cfg->count; b++) {
+        l->live_in[b] = new_set(l);
+        l->live_out[b] = new_set(l);
+    }
+
+    Word* live = new_set(l);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = cfg->count - 1; b >= 0; b--) {
+            BasicBlock* block = &cfg->blocks[b];
+            for (int s = 0; s < block->successors_count; s++) {
+                Word* in = l->live_in[block->successors[s]];
+                for (int w = 0; w < l->words; w++) {
+                    l->live_out[b][w] |= in[w];
+                }
+            }
+
+            get_block_end(l, b, live);
+            for (int s = block->statements_count - 1; s >= 0; s--) {
+                transfer(l, block->statements[s], live);
+            }
+
+            for (int w = 0; w < l->words; w++) {
+                if ((live[w] & ~l->live_in[b][w]) != 0) {
+                    l->live_in[b][w] |= live[w];
+                    changed = true;
+                }
+            }
+        }
+    }
+    free(live);
+
+    return l;
+}
+
+static void free_liveness(Liveness* l) {
+    for (int b = 0; b < l->cfg->count; b++) {
+        free(l->live_in[b]);
+        free(l->live_out[b]);
+    }
+    free(l->live_in);
+    free(l->live_out);
+    free(l->local);
+    free_control_flow_graph(l->cfg);
+    free(l);
+}
+
+// computing the value has no effect but the store, and compiling it reports nothing
+static bool is_removable_value(ControlFlowGraph* cfg, Node* e) {
+    int value;
+    switch (e->label) {
+    case num:
+    case character:
+        return true;
+
+    case ident:
+        return cfg_variable_index(cfg, e->ident) != -1;
+
+    case divstar:
+        if (e->byte != '*' && (!get_constant_value(SECONDCHILD(e), &value) || value == 0 || value == -1)) return false;
+        break;
+
+    case addsub:
+    case eq:
+    case order:
+    case not:
+    case and:
+    case or:
+        break;
+
+    default:
+        return false;
+    }
+
+    for (Node *child = e->firstChild; child != NULL; child = child->nextSibling) {
+        if (!is_removable_value(cfg, child)) return false;
+    }
+    return true;
+}
+
+// a char assigned something else than a char would warn when compiled
+static bool is_removable_store(ControlFlowGraph* cfg, Variable* target, Node* e) {
+    if (!is_removable_value(cfg, e)) return false;
+    if (target->integer || e->label == character) return true;
+    return e->label == ident && !cfg->variables[cfg_variable_index(cfg, e->ident)].integer;
+}
+
+// the statement becomes an empty block, wherever it is
+static void remove_statement(Node* instr) {
+    deleteTree(instr->firstChild);
+    instr->firstChild = NULL;
+    instr->label = body;
+}
+
+static bool remove_dead_stores(Liveness* l) {
+    ControlFlowGraph* cfg = l->cfg;
+    Word* live = new_set(l);
+    bool removed = false;
+
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        get_block_end(l, b, live);
+
+        for (int s = block->statements_count - 1; s >= 0; s--) {
+            Node* instr = block->statements[s];
+            if (instr->label == assignment) {
+                int i = cfg_variable_index(cfg, FIRSTCHILD(instr)->ident);
+                Variable* variable = i != -1 ? &cfg->variables[i] : NULL;
+
+                if (variable != NULL && !variable->global && !is_live(live, l->local[i]) && is_removable_store(cfg, variable, SECONDCHILD(instr))) {
+                    remove_statement(instr);
+                    stats.dead_stores++;
+                    removed = true;
+                    continue;
+                }
+            }
+            transfer(l, instr, live);
+        }
+    }
+
+    free(live);
+    return removed;
+}
+
+void eliminate_dead_stores(Node* func, SymbolTable* global) {
+    // a removed store can leave the ones feeding it dead
+    bool removed = true;
+    while (removed) {
+        Liveness* l = new_liveness(func, global);
+        removed = remove_dead_stores(l);
+        free_liveness(l);
+    }
+}
+
+typedef struct {
+    char* name;
+    int variable;           // index in the graph, -1 if the body does not use it
+    bool parameter;         // stored by the prologue
+    int size;               // only slots of the same size are shared
+} Slot;
+
+static void interfere(bool* interference, int count, int a, int b) {
+    if (a == b) return;
+    interference[a * count + b] = true;
+    interference[b * count + a] = true;
+}
+
+static void add_slot(Slot* slots, int* count, ControlFlowGraph* cfg, SymbolTable* local, Node* var, bool parameter) {
+    int i = cfg_variable_index(cfg, var->ident);
+    if (i == -1 && !parameter) return;
+
+    slots[*count].name = var->ident;
+    slots[*count].variable = i;
+    slots[*count].parameter = parameter;
+    slots[*count].size = get_type_size(table_get_type(local, var->ident));
+    (*count)++;
+}
+
+void share_stack_slots(Node* func, SymbolTable* global, SymbolTable* local) {
+    Liveness* l = new_liveness(func, global);
+    ControlFlowGraph* cfg = l->cfg;
+
+    Node* parameters = THIRDCHILD(FIRSTCHILD(func));
+    Node* declarations = FIRSTCHILD(SECONDCHILD(func));
+    int capacity = count_nodes(parameters) + count_nodes(declarations);
+    Slot* slots = (Slot*)malloc(sizeof(Slot) * capacity);
+    int* candidate = (int*)malloc(sizeof(int) * (l->locals_count > 0 ? l->locals_count : 1));
+    if (slots == NULL || candidate == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+
+    // parameters past the sixth stay where the caller stored them
+    int count = 0;
+    int j = 0;
+    for (Node *type = parameters->firstChild; type != NULL && j < 6; type = type->nextSibling, j++) {
+        if (table_get_symbol(local, FIRSTCHILD(type)->ident)->reg == NULL) {
+            add_slot(slots, &count, cfg, local, FIRSTCHILD(type), true);
+        }
+    }
+    for (Node *type = declarations->firstChild; type != NULL; type = type->nextSibling) {
+        for (Node *var = type->firstChild; var != NULL; var = var->nextSibling) {
+            add_slot(slots, &count, cfg, local, var, false);
+        }
+    }
+
+    for (int i = 0; i < l->locals_count; i++) {
+        candidate[i] = -1;
+    }
+    for (int k = 0; k < count; k++) {
+        if (slots[k].variable != -1) candidate[l->local[slots[k].variable]] = k;
+    }
+
+    bool* interference = (bool*)calloc(count > 0 ? count * count : 1, sizeof(bool));
+    Word* live = new_set(l);
+    if (interference == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+
+    // parameters and variables read before any assignment all hold a value at the entry
+    Word* entry = l->live_in[CFG_ENTRY];
+    for (int a = 0; a < count; a++) {
+        for (int b = 0; b < count; b++) {
+            bool defined_a = slots[a].parameter || (slots[a].variable != -1 && is_live(entry, l->local[slots[a].variable]));
+            bool defined_b = slots[b].parameter || (slots[b].variable != -1 && is_live(entry, l->local[slots[b].variable]));
+            if (defined_a && defined_b) interfere(interference, count, a, b);
+        }
+    }
+
+    // an assigned variable interferes with everything live after the assignment
+    for (int b = 0; b < cfg->count; b++) {
+        BasicBlock* block = &cfg->blocks[b];
+        get_block_end(l, b, live);
+
+        for (int s = block->statements_count - 1; s >= 0; s--) {
+            Node* instr = block->statements[s];
+            if (instr->label == assignment) {
+                int i = get_local(l, FIRSTCHILD(instr)->ident);
+                if (i != -1 && candidate[i] != -1) {
+                    for (int v = 0; v < l->locals_count; v++) {
+                        if (is_live(live, v) && candidate[v] != -1) interfere(interference, count, candidate[i], candidate[v]);
+                    }
+                }
+            }
+            transfer(l, instr, live);
+        }
+    }
+
+    // first fit, in the order of the declarations, ints and chars apart
+    int* colors = (int*)malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (colors == NULL) {
+        perror("Liveness");
+        exit(3);
+    }
+    int used[5] = {0};
+    for (int a = 0; a < count; a++) {
+        int color = 0;
+        for (bool taken = true; taken; ) {
+            taken = false;
+            for (int b = 0; b < a; b++) {
+                if (slots[b].size == slots[a].size && colors[b] == color && interference[a * count + b]) {
+                    taken = true;
+                    color++;
+                    break;
+                }
+            }
+        }
+        colors[a] = color;
+        if (color + 1 > used[slots[a].size]) used[slots[a].size] = color + 1;
+    }
+
+    // the chars are packed after the ints, like fillSymbolTable lays them out
+    for (int a = 0; a < count; a++) {
+        Symbol* symbol = table_get_symbol(local, slots[a].name);
+        if (slots[a].size == 4) {
+            symbol->address = (colors[a] + 1) * 4;
+        }
+        else {
+            symbol->address = used[4] * 4 + colors[a] + 1;
+        }
+    }
+
+    int size = used[4] * 4 + used[1];
+    stats.stack_bytes_saved += local->size - size;
+    local->size = size;
+
+    free(colors);
+    free(interference);
+    free(live);
+    free(candidate);
+    free(slots);
+    free_liveness(l);
+}
@@ -0,0 +1,15 @@
+#ifndef __LIVENESS__
+#define __LIVENESS__
+
+#include "tree.h"
+#include "SymbolTable.h"
+
+// removes the assignments to locals whose value is never read,
+// when computing it can neither call, trap nor hide a semantic error
+void eliminate_dead_stores(Node* func, SymbolTable* global);
+
+// gives the locals the slots of the frame, the same one to those never live at once
+// and none to those the body does not use; parameters kept in registers need none
+void share_stack_slots(Node* func, SymbolTable* global, SymbolTable* local);
+
+#endif
@@ -0,0 +1,515 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "Peephole.h"
+
+static void parse_line(Instruction* instr, char* line) {
+    memset(instr, 0, sizeof(Instruction));
+    strncpy(instr->text, line, sizeof(instr->text) - 1);
+
+    while (isspace((unsigned char)*line)) line++;
+
+    size_t length = strlen(line);
+    while (length > 0 && isspace((unsigned char)line[length - 1])) line[--length] = '\0';
+
+    if (length == 0) {
+        instr->kind = LINE_BLANK;
+        return;
+    }
+    if (line[0] == ';') {
+        instr->kind = LINE_COMMENT;
+        return;
+    }
+    if (line[length - 1] == ':' && strchr(line, ' ') == NULL) {
+        if (length - 1 >= sizeof(instr->label)) {
+            instr->kind = LINE_UNPARSED;
+            return;
+        }
+        instr->kind = LINE_LABEL;
+        strncpy(instr->label, line, length - 1);
+        return;
+    }
+
+    instr->kind = LINE_INSTRUCTION;
+
+    int i = 0;
+    while (line[i] != '\0' && !isspace((unsigned char)line[i])) {
+        if (i == (int)sizeof(instr->op) - 1) {
+            instr->kind = LINE_UNPARSED;
+            return;
+        }
+        instr->op[i] = line[i];
+        i++;
+    }
+    char* operands = line + i;
+
+    // operands are separated by the commas outside of brackets
+    int depth = 0;
+    char* start = operands;
+    for (char* c = operands; ; c++) {
+        if (*c == '[') depth++;
+        if (*c == ']') depth--;
+        if ((*c == ',' && depth == 0) || *c == '\0') {
+            while (start < c && isspace((unsigned char)*start)) start++;
+            char* end = c;
+            while (end > start && isspace((unsigned char)end[-1])) end--;
+
+            if (end > start) {
+                // a truncated operand could match another one sharing its prefix
+                if (instr->operands_count == MAX_OPERANDS || end - start >= MAX_OPERAND_LENGTH) {
+                    instr->kind = LINE_UNPARSED;
+                    instr->operands_count = 0;
+                    return;
+                }
+                strncpy(instr->operands[instr->operands_count], start, end - start);
+                instr->operands_count++;
+            }
+            if (*c == '\0') break;
+            start = c + 1;
+        }
+    }
+}
+
+static void append(InstructionList* list, char* start, size_t length) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        list->instructions = (Instruction*)realloc(list->instructions, sizeof(Instruction) * list->capacity);
+        if (list->instructions == NULL) {
+            perror("InstructionList");
+            exit(3);
+        }
+    }
+    Instruction* instr = &list->instructions[list->count++];
+
+    if (length >= MAX_LINE_LENGTH) {
+        memset(instr, 0, sizeof(Instruction));
+        instr->kind = LINE_UNPARSED;
+        instr->long_text = strndup(start, length);
+        if (instr->long_text == NULL) {
+            perror("InstructionList");
+            exit(3);
+        }
+        return;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    memcpy(line, start, length);
+    line[length] = '\0';
+    parse_line(instr, line);
+
+    // the code generator writes the depth of the expression stack after each push and pop,
+    // any other access to a slot only reads or writes it
+    if (instr->kind == LINE_COMMENT && list->count > 1 && strstr(instr->text, "; stack:") != NULL) {
+        Instruction* previous = &list->instructions[list->count - 2];
+        if (previous->kind == LINE_INSTRUCTION) previous->moves_stack = true;
+    }
+}
+
+InstructionList* parse_instructions(char* buffer, size_t size) {
+    InstructionList* list = (InstructionList*)malloc(sizeof(InstructionList));
+    if (list == NULL) {
+        perror("InstructionList");
+        exit(3);
+    }
+    list->instructions = NULL;
+    list->count = 0;
+    list->capacity = 0;
+
+    size_t start = 0;
+    for (size_t i = 0; i <= size; i++) {
+        if (i == size || buffer[i] == '\n') {
+            if (i == size && start == size) break;
+
+            append(list, buffer + start, i - start);
+            start = i + 1;
+        }
+    }
+
+    return list;
+}
+
+void free_instructions(InstructionList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->instructions[i].long_text);
+    }
+    free(list->instructions);
+    free(list);
+}
+
+void write_instructions(InstructionList* list, FILE* file) {
+    for (int i = 0; i < list->count; i++) {
+        Instruction* instr = &list->instructions[i];
+        if (instr->deleted) continue;
+        fprintf(file, "%s\n", instr->long_text != NULL ? instr->long_text : instr->text);
+    }
+}
+
+static void set_instruction(Instruction* instr, char* op, char* a, char* b) {
+    strcpy(instr->op, op);
+    instr->moves_stack = false;
+    instr->operands_count = 0;
+    if (a != NULL) strcpy(instr->operands[instr->operands_count++], a);
+    if (b != NULL) strcpy(instr->operands[instr->operands_count++], b);
+
+    if (b != NULL) snprintf(instr->text, sizeof(instr->text), "\t%s %s, %s", op, a, b);
+    else if (a != NULL) snprintf(instr->text, sizeof(instr->text), "\t%s %s", op, a);
+    else snprintf(instr->text, sizeof(instr->text), "\t%s", op);
+}
+
+static bool is_op(Instruction* instr, char* op) {
+    return instr != NULL && instr->kind == LINE_INSTRUCTION && strcmp(instr->op, op) == 0;
+}
+
+// comments and blank lines never break a window, labels do
+static int next_index(InstructionList* list, int i) {
+    for (i++; i < list->count; i++) {
+        Instruction* instr = &list->instructions[i];
+        if (instr->deleted || instr->kind == LINE_COMMENT || instr->kind == LINE_BLANK) continue;
+        return i;
+    }
+    return -1;
+}
+
+static Instruction* get(InstructionList* list, int i) {
+    return i == -1 ? NULL : &list->instructions[i];
+}
+
+static const char* registers[][5] = {
+    {"rax", "eax", "ax", "al", "ah"},
+    {"rbx", "ebx", "bx", "bl", "bh"},
+    {"rcx", "ecx", "cx", "cl", "ch"},
+    {"rdx", "edx", "dx", "dl", "dh"},
+    {"rsi", "esi", "si", "sil", NULL},
+    {"rdi", "edi", "di", "dil", NULL},
+    {"rbp", "ebp", "bp", "bpl", NULL},
+    {"rsp", "esp", "sp", "spl", NULL},
+    {"r8", "r8d", "r8w", "r8b", NULL},
+    {"r9", "r9d", "r9w", "r9b", NULL},
+    {"r10", "r10d", "r10w", "r10b", NULL},
+    {"r11", "r11d", "r11w", "r11b", NULL},
+    {"r12", "r12d", "r12w", "r12b", NULL},
+    {"r13", "r13d", "r13w", "r13b", NULL},
+    {"r14", "r14d", "r14w", "r14b", NULL},
+    {"r15", "r15d", "r15w", "r15b", NULL},
+};
+
+// index of the 64 bits register containing the operand, -1 if not a register
+static int register_family(char* operand) {
+    for (int i = 0; i < (int)(sizeof(registers) / sizeof(registers[0])); i++) {
+        for (int j = 0; j < 5; j++) {
+            if (registers[i][j] != NULL && strcmp(registers[i][j], operand) == 0) return i;
+        }
+    }
+    return -1;
+}
+
+static bool is_register64(char* operand) {
+    int family = register_family(operand);
+    return family != -1 && strcmp(registers[family][0], operand) == 0;
+}
+
+static bool is_immediate(char* operand) {
+    char* c = operand;
+    if (*c == '-') c++;
+    if (!isdigit((unsigned char)*c)) return false;
+    for (; *c != '\0'; c++) {
+        if (!isdigit((unsigned char)*c)) return false;
+    }
+    return true;
+}
+
+// instructions writing only their first operand, without touching the stack
+static bool writes_only_destination(Instruction* instr) {
+    static const char* ops[] = {
+        "mov", "movzx", "movsx", "movsxd", "lea", "add", "sub", "and", "or", "xor",
+        "shl", "shr", "sar", "neg", "not", "inc", "dec", "cmp", "test", NULL,
+    };
+
+    if (instr->kind != LINE_INSTRUCTION || instr->operands_count == 0) return false;
+    if (is_op(instr, "imul") && instr->operands_count >= 2) return true;
+
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (strcmp(instr->op, ops[i]) == 0) {
+            for (int j = 0; j < instr->operands_count; j++) {
+                if (strstr(instr->operands[j], "rsp") != NULL) return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// functions making calls keep their expression stack in qword slots above rsp
+static bool is_stack_slot(char* operand) {
+    return strncmp(operand, "qword [rsp", 10) == 0;
+}
+
+// push X or mov qword [rsp + N], X
+static bool is_stack_push(Instruction* instr) {
+    if (is_op(instr, "push")) return true;
+    return is_op(instr, "mov") && instr->moves_stack && instr->operands_count == 2 && is_stack_slot(instr->operands[0]);
+}
+
+// pop R or mov R, qword [rsp + N]
+static bool is_stack_pop(Instruction* instr) {
+    if (is_op(instr, "pop")) return true;
+    return is_op(instr, "mov") && instr->moves_stack && instr->operands_count == 2 && is_stack_slot(instr->operands[1]);
+}
+
+static char* pushed_value(Instruction* instr) {
+    return is_op(instr, "push") ? instr->operands[0] : instr->operands[1];
+}
+
+// a slot is read once, the value pushed is the one popped
+static bool same_slot(Instruction* push, Instruction* pop) {
+    if (is_op(push, "push") || is_op(pop, "pop")) return is_op(push, "push") && is_op(pop, "pop");
+    return strcmp(push->operands[0], pop->operands[1]) == 0;
+}
+
+static bool writes_register(Instruction* instr, int family) {
+    if (is_op(instr, "cmp") || is_op(instr, "test")) return false;
+    return register_family(instr->operands[0]) == family;
+}
+
+// push R / pop R
+static bool push_pop_same(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    Instruction* b = get(list, next_index(list, i));
+    if (!is_stack_push(a) || !is_stack_pop(b) || !same_slot(a, b)) return false;
+    if (strcmp(pushed_value(a), b->operands[0]) != 0) return false;
+
+    a->deleted = true;
+    b->deleted = true;
+    return true;
+}
+
+// push X / pop R -> mov R, X
+static bool push_pop_move(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    Instruction* b = get(list, next_index(list, i));
+    if (!is_stack_push(a) || !is_stack_pop(b) || !same_slot(a, b)) return false;
+    if (!is_register64(pushed_value(a)) && !is_immediate(pushed_value(a))) return false;
+
+    char source[64];
+    strcpy(source, pushed_value(a));
+    set_instruction(b, "mov", b->operands[0], source);
+    a->deleted = true;
+    return true;
+}
+
+// pop R / push R -> mov R, [rsp]
+// slots are left alone, deleting the store would break the push/pop forwarding above
+static bool pop_push_same(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    Instruction* b = get(list, next_index(list, i));
+    if (!is_op(a, "pop") || !is_op(b, "push")) return false;
+    if (strcmp(a->operands[0], b->operands[0]) != 0 || !is_register64(a->operands[0])) return false;
+
+    set_instruction(a, "mov", a->operands[0], "[rsp]");
+    b->deleted = true;
+    return true;
+}
+
+// push R / I / pop R2 -> I / mov R2, R when I does not touch R nor the stack
+static bool push_over_instruction(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    int j = next_index(list, i);
+    Instruction* b = get(list, j);
+    Instruction* c = get(list, next_index(list, j));
+    if (!is_stack_push(a) || !is_stack_pop(c) || b == NULL || !same_slot(a, c)) return false;
+    if (!is_register64(pushed_value(a)) || !is_register64(c->operands[0])) return false;
+    if (!writes_only_destination(b) || writes_register(b, register_family(pushed_value(a)))) return false;
+
+    char source[64];
+    strcpy(source, pushed_value(a));
+    a->deleted = true;
+    if (strcmp(source, c->operands[0]) == 0) {
+        c->deleted = true;
+    }
+    else {
+        set_instruction(c, "mov", c->operands[0], source);
+    }
+    return true;
+}
+
+// mov R, R
+static bool move_to_itself(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    if (!is_op(a, "mov") || a->operands_count != 2) return false;
+    if (register_family(a->operands[0]) == -1 || strcmp(a->operands[0], a->operands[1]) != 0) return false;
+
+    a->deleted = true;
+    return true;
+}
+
+// size index of a register in its family row, -1 if not a register
+static int register_size(char* operand) {
+    int family = register_family(operand);
+    if (family == -1) return -1;
+
+    for (int j = 0; j < 5; j++) {
+        if (registers[family][j] != NULL && strcmp(registers[family][j], operand) == 0) return j;
+    }
+    return -1;
+}
+
+// mov [A], R / mov R2, [A] -> the loaded value is already in R
+static bool store_load(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    Instruction* b = get(list, next_index(list, i));
+    if (!is_op(a, "mov") || !is_op(b, "mov")) return false;
+    if (a->operands_count != 2 || b->operands_count != 2) return false;
+    if (strchr(a->operands[0], '[') == NULL || register_family(a->operands[1]) == -1) return false;
+    if (strcmp(a->operands[0], b->operands[1]) != 0) return false;
+    if (register_size(a->operands[1]) != register_size(b->operands[0])) return false;
+
+    if (strcmp(a->operands[1], b->operands[0]) == 0) {
+        b->deleted = true;
+    }
+    else {
+        char source[64];
+        strcpy(source, a->operands[1]);
+        set_instruction(b, "mov", b->operands[0], source);
+    }
+    return true;
+}
+
+// jmp L / L:
+static bool jump_to_next(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    if (!is_op(a, "jmp")) return false;
+
+    for (int j = next_index(list, i); j != -1; j = next_index(list, j)) {
+        Instruction* b = get(list, j);
+        if (b->kind != LINE_LABEL) return false;
+        if (strcmp(b->label, a->operands[0]) == 0) {
+            a->deleted = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// jcc L1 / jmp L2 / L1: -> jncc L2 / L1:
+static bool branch_over_jump(InstructionList* list, int i) {
+    static const char* conditions[][2] = {
+        {"je", "jne"}, {"jne", "je"}, {"jl", "jge"}, {"jge", "jl"}, {"jg", "jle"}, {"jle", "jg"},
+    };
+
+    Instruction* a = get(list, i);
+    int j = next_index(list, i);
+    Instruction* b = get(list, j);
+    Instruction* c = get(list, next_index(list, j));
+    if (a == NULL || a->kind != LINE_INSTRUCTION || !is_op(b, "jmp") || c == NULL || c->kind != LINE_LABEL) return false;
+    if (strcmp(a->operands[0], c->label) != 0) return false;
+
+    for (int k = 0; k < (int)(sizeof(conditions) / sizeof(conditions[0])); k++) {
+        if (strcmp(a->op, conditions[k][0]) == 0) {
+            char target[64];
+            strcpy(target, b->operands[0]);
+            set_instruction(a, (char*)conditions[k][1], target, NULL);
+            b->deleted = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// nothing after jmp or ret runs until the next label
+static bool unreachable_code(InstructionList* list, int i) {
+    Instruction* a = get(list, i);
+    if (!is_op(a, "jmp") && !is_op(a, "ret")) return false;
+
+    Instruction* b = get(list, next_index(list, i));
+    if (b == NULL || b->kind != LINE_INSTRUCTION) return false;
+
+    b->deleted = true;
+    return true;
+}
+
+typedef struct {
+    const char* name;
+    bool (*rewrite)(InstructionList* list, int i);
+    int count;
+} Pattern;
+
+static Pattern patterns[] = {
+    {"push/pop same register", push_pop_same, 0},
+    {"push/pop into move", push_pop_move, 0},
+    {"pop/push same register", pop_push_same, 0},
+    {"push/pop around instruction", push_over_instruction, 0},
+    {"move to itself", move_to_itself, 0},
+    {"store then load", store_load, 0},
+    {"jump to next label", jump_to_next, 0},
+    {"branch over jump", branch_over_jump, 0},
+    {"unreachable code", unreachable_code, 0},
+};
+
+#define PATTERNS_COUNT (int)(sizeof(patterns) / sizeof(patterns[0]))
+
+void peephole_optimize(InstructionList* list) {
+    bool changed = true;
+
+    // a rewrite can expose another one before it, passes run until nothing matches
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < list->count; i++) {
+            Instruction* instr = &list->instructions[i];
+            if (instr->deleted || instr->kind == LINE_COMMENT || instr->kind == LINE_BLANK) continue;
+
+            for (int p = 0; p < PATTERNS_COUNT; p++) {
+                if (patterns[p].rewrite(list, i)) {
+                    patterns[p].count++;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// every instruction falls in one class at most, lea reads no memory
+void count_instruction_classes(InstructionList* list, FunctionStats* function) {
+    for (int i = 0; i < list->count; i++) {
+        Instruction* instr = &list->instructions[i];
+        if (instr->deleted || instr->kind != LINE_INSTRUCTION) continue;
+
+        function->instructions++;
+        if (is_stack_push(instr) || is_stack_pop(instr)) {
+            function->stack++;
+        }
+        else if (is_op(instr, "call")) {
+            function->calls++;
+        }
+        else if (instr->op[0] == 'j') {
+            function->branches++;
+        }
+        else if (is_op(instr, "idiv") || is_op(instr, "div")) {
+            function->divisions++;
+        }
+        else if (is_op(instr, "lea")) {
+            continue;
+        }
+        else if (instr->operands_count > 0 && strchr(instr->operands[0], '[') != NULL && !is_op(instr, "cmp") && !is_op(instr, "test")) {
+            function->stores++;
+        }
+        else {
+            for (int j = 0; j < instr->operands_count; j++) {
+                if (strchr(instr->operands[j], '[') != NULL) {
+                    function->loads++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void print_peephole_stats(FILE* file) {
+    fprintf(file, "\tpeephole:\n");
+    for (int p = 0; p < PATTERNS_COUNT; p++) {
+        fprintf(file, "\t\t%s: %d\n", patterns[p].name, patterns[p].count);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef __PEEPHOLE__
+#define __PEEPHOLE__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "stats.h"
+
+#define MAX_OPERANDS 3
+// the longest operand emitted is an identifier of 63 characters with a size, rel and a displacement
+#define MAX_OPERAND_LENGTH 128
+#define MAX_LINE_LENGTH (MAX_OPERANDS * MAX_OPERAND_LENGTH + 32)
+
+typedef enum {
+    LINE_BLANK,
+    LINE_COMMENT,
+    LINE_LABEL,
+    LINE_INSTRUCTION,
+    LINE_UNPARSED,                      // longer than the buffers, written back as is and never rewritten
+} LineKind;
+
+typedef struct {
+    LineKind kind;
+    char text[MAX_LINE_LENGTH];         // line as emitted, regenerated when rewritten
+    char* long_text;                    // the line of an unparsed instruction too long for text
+    char op[16];
+    char operands[MAX_OPERANDS][MAX_OPERAND_LENGTH];
+    int operands_count;
+    char label[64];
+    bool moves_stack;                   // followed by the "; stack:" comment of a push or a pop
+    bool deleted;
+} Instruction;
+
+typedef struct {
+    Instruction* instructions;
+    int count;
+    int capacity;
+} InstructionList;
+
+InstructionList* parse_instructions(char* buffer, size_t size);
+void free_instructions(InstructionList* list);
+void write_instructions(InstructionList* list, FILE* file);
+
+void peephole_optimize(InstructionList* list);
+void print_peephole_stats(FILE* file);
+
+void count_instruction_classes(InstructionList* list, FunctionStats* function);
+
+#endif
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "Profile.h"
+
+static long long* counts = NULL;
+static int counts_count = 0;
+static unsigned int shape = 0;
+
+// FNV-1a over the labels of the nodes, each list of children closed by a 0
+static unsigned int add_to_shape(unsigned int hash, int word) {
+    return (hash ^ (unsigned int)word) * 16777619u;
+}
+
+static int get_counters_count(Node* node) {
+    switch (node->label) {
+    case if_:
+    case while_:
+        return 2;
+
+    case function:
+    case case_:
+    case default_:
+    case function_call:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static void number_counters(Node* node, int* next) {
+    int count = get_counters_count(node);
+    if (count != 0) {
+        node->profile = *next;
+        *next += count;
+    }
+    shape = add_to_shape(shape, node->label + 1);
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        number_counters(child, next);
+    }
+    shape = add_to_shape(shape, 0);
+}
+
+int number_profile_counters(Node* functions) {
+    int next = 0;
+    shape = 2166136261u;
+    for (Node *func = functions->firstChild; func != NULL; func = func->nextSibling) {
+        number_counters(func, &next);
+    }
+    return next;
+}
+
+void load_profile(char* path, int count) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror("Cannot open profile");
+        exit(3);
+    }
+
+    int recorded;
+    unsigned int recorded_shape;
+    if (fscanf(file, "tpc-profile %d %u", &recorded, &recorded_shape) != 2 || recorded != count || recorded_shape != shape) {
+        fprintf(stderr, "Warning: profile %s was not recorded for this program, ignored\n", path);
+        fclose(file);
+        return;
+    }
+
+    counts = (long long*)calloc(count > 0 ? count : 1, sizeof(long long));
+    if (counts == NULL) {
+        perror("load_profile");
+        exit(3);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (fscanf(file, "%lld", &counts[i]) != 1) {
+            fprintf(stderr, "Warning: profile %s is truncated, ignored\n", path);
+            free_profile();
+            fclose(file);
+            return;
+        }
+    }
+    counts_count = count;
+
+    fclose(file);
+}
+
+unsigned int profile_shape(void) {
+    return shape;
+}
+
+void free_profile(void) {
+    free(counts);
+    counts = NULL;
+    counts_count = 0;
+}
+
+bool profile_loaded(void) {
+    return counts != NULL;
+}
+
+long long profile_count(Node* node, int counter) {
+    if (counts == NULL || node == NULL || node->profile == -1) return 0;
+    if (node->profile + counter >= counts_count) return 0;
+    return counts[node->profile + counter];
+}
@@ -0,0 +1,33 @@
+#ifndef __PROFILE__
+#define __PROFILE__
+
+#include <stdbool.h>
+#include "tree.h"
+
+// file written at exit by a program compiled with --instrument
+#define PROFILE_FILE "tpc.profile"
+
+// counters of a node, from its first one: the entries of a function, the executions
+// of an if then those of its then branch, the entries of a while then its iterations,
+// the executions of a case, a default or a call
+#define PROFILE_EXECUTIONS 0
+#define PROFILE_TAKEN 1
+#define PROFILE_ITERATIONS 1
+
+// numbers the counters in the order of the source, before any pass changes the tree,
+// so that the instrumented program and the one using its profile agree; returns their count
+int number_profile_counters(Node* functions);
+
+// hash of the labels of the tree the counters were numbered on, written in the header of
+// the profile next to their count
+unsigned int profile_shape(void);
+
+// reads the counts of the program, a profile of another program is ignored with a warning
+void load_profile(char* path, int count);
+void free_profile(void);
+bool profile_loaded(void);
+
+// 0 without profile and for the nodes that have no counter
+long long profile_count(Node* node, int counter);
+
+#endif
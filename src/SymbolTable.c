@@ -15,6 +15,8 @@ Symbol* new_symbol(Type type, char* ident) {
     symbol->type = type;
     strcpy(symbol->ident, ident);
     symbol->address = -1;
+    symbol->referenced = false;
+    symbol->reg = NULL;
 
     return symbol;
 }
@@ -118,6 +120,21 @@ int table_get_address(SymbolTable* table, char* value) {
     exit(2);
 }
 
+Symbol* table_get_symbol(SymbolTable* table, char* value) {
+    int h = hash(value);
+    LinkedBuckets* linked = &table->buckets[h];
+
+    for (SymbolNode* node = linked->head; node != NULL; node = node->next) {
+        Symbol* s = node->symbol;
+        
+        if (strcmp(value, s->ident) == 0) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
 bool insert_symbol(SymbolTable* table, Symbol* symbol) {
     if (table_contains(table, symbol->ident)) return false;
 
@@ -35,6 +35,8 @@ typedef struct {
     Type type;
     char ident[50];
     int address;
+    bool referenced;
+    char* reg;          // register holding the variable, NULL when it lives in memory
 } Symbol;
 
 typedef struct SymbolNode {
@@ -60,6 +62,7 @@ int hash(char* str);
 bool table_contains(SymbolTable* table, char* value);
 Type table_get_type(SymbolTable* table, char* value);
 int table_get_address(SymbolTable* table, char* value);
+Symbol* table_get_symbol(SymbolTable* table, char* value);
 
 bool insert_symbol(SymbolTable* table, Symbol* symbol);
 void print_table(SymbolTable* table);
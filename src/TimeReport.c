@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "TimeReport.h"
+#include "options.h"
+
+long allocations_count = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    allocations_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocations_count++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocations_count++;
+    return __real_realloc(pointer, size);
+}
+
+typedef struct {
+    double seconds;
+    long allocations;
+    double start;
+    long start_allocations;
+} Measure;
+
+typedef struct {
+    char name[64];
+    double seconds;
+    long allocations;
+} FunctionMeasure;
+
+static const char* phase_names[PHASES_COUNT] = {
+    "parse",
+    "declarations",
+    "analysis",
+    "functions",
+    "output",
+    "free",
+};
+
+static double origin = 0;
+static Measure phases[PHASES_COUNT];
+static Measure current;
+static FunctionMeasure* measures = NULL;
+static int functions_count = 0;
+static int functions_capacity = 0;
+static int nodes_count = 0;
+static int symbols_count = 0;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void start(Measure* m) {
+    m->start = now();
+    m->start_allocations = allocations_count;
+}
+
+static void stop(Measure* m) {
+    m->seconds += now() - m->start;
+    m->allocations += allocations_count - m->start_allocations;
+}
+
+void time_report_begin(void) {
+    origin = now();
+}
+
+void time_report_start(Phase phase) {
+    if (!options.time_report) return;
+    start(&phases[phase]);
+}
+
+void time_report_stop(Phase phase) {
+    if (!options.time_report) return;
+    stop(&phases[phase]);
+}
+
+void time_report_function_start(void) {
+    if (!options.time_report) return;
+    current.seconds = 0;
+    current.allocations = 0;
+    start(&current);
+}
+
+void time_report_function_stop(char* name) {
+    if (!options.time_report) return;
+    stop(&current);
+
+    if (functions_count == functions_capacity) {
+        functions_capacity = functions_capacity == 0 ? 16 : functions_capacity * 2;
+        measures = (FunctionMeasure*)realloc(measures, sizeof(FunctionMeasure) * functions_capacity);
+        if (measures == NULL) {
+            perror("time_report");
+            exit(3);
+        }
+    }
+
+    FunctionMeasure* f = &measures[functions_count++];
+    strncpy(f->name, name, sizeof(f->name) - 1);
+    f->name[sizeof(f->name) - 1] = '\0';
+    f->seconds = current.seconds;
+    f->allocations = current.allocations;
+}
+
+static int count_tree_nodes(Node* node) {
+    int count = 1;
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        count += count_tree_nodes(child);
+    }
+    return count;
+}
+
+// the tree as parsed, before the passes add or remove nodes
+void time_report_count_nodes(Node* tree) {
+    if (!options.time_report) return;
+    nodes_count = count_tree_nodes(tree);
+}
+
+static int count_symbols(Node* node) {
+    int count = 0;
+    if (node->sym_table != NULL) {
+        for (int i = 0; i < N; i++) {
+            for (SymbolNode* s = node->sym_table->buckets[i].head; s != NULL; s = s->next) {
+                count++;
+            }
+        }
+    }
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        count += count_symbols(child);
+    }
+    return count;
+}
+
+// the tables of the program and of its functions, before deleteTree frees them
+void time_report_count_symbols(Node* tree) {
+    if (!options.time_report) return;
+    symbols_count = count_symbols(tree);
+}
+
+static int compare_functions(const void* a, const void* b) {
+    double x = ((FunctionMeasure*)a)->seconds;
+    double y = ((FunctionMeasure*)b)->seconds;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static long get_peak_rss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+static void print_text(FILE* file, double total, long peak_rss, int slowest) {
+    fprintf(file, "time report:\n");
+    for (int p = 0; p < PHASES_COUNT; p++) {
+        fprintf(file, "\t%s: %.3f ms, %ld allocations\n", phase_names[p], phases[p].seconds * 1000, phases[p].allocations);
+    }
+    fprintf(file,
+        "\ttotal: %.3f ms, %ld allocations\n"
+        "\tpeak rss: %ld KB\n"
+        "\tnodes: %d\n"
+        "\tsymbols: %d\n"
+        "\tfunctions: %d\n"
+        "\tslowest functions:\n",
+        total * 1000, allocations_count,
+        peak_rss,
+        nodes_count,
+        symbols_count,
+        functions_count
+    );
+    for (int i = 0; i < slowest; i++) {
+        fprintf(file, "\t\t%s: %.3f ms, %ld allocations\n", measures[i].name, measures[i].seconds * 1000, measures[i].allocations);
+    }
+}
+
+// identifiers need no escaping in a JSON string
+static void print_json(FILE* file, double total, long peak_rss, int slowest) {
+    fprintf(file, "{\n\t\"phases\": {\n");
+    for (int p = 0; p < PHASES_COUNT; p++) {
+        fprintf(file, "\t\t\"%s\": {\"seconds\": %.9f, \"allocations\": %ld}%s\n",
+            phase_names[p], phases[p].seconds, phases[p].allocations, p + 1 < PHASES_COUNT ? "," : "");
+    }
+    fprintf(file,
+        "\t},\n"
+        "\t\"total\": {\"seconds\": %.9f, \"allocations\": %ld},\n"
+        "\t\"peak_rss_kb\": %ld,\n"
+        "\t\"nodes\": %d,\n"
+        "\t\"symbols\": %d,\n"
+        "\t\"functions\": %d,\n"
+        "\t\"slowest_functions\": [\n",
+        total, allocations_count,
+        peak_rss,
+        nodes_count,
+        symbols_count,
+        functions_count
+    );
+    for (int i = 0; i < slowest; i++) {
+        fprintf(file, "\t\t{\"name\": \"%s\", \"seconds\": %.9f, \"allocations\": %ld}%s\n",
+            measures[i].name, measures[i].seconds, measures[i].allocations, i + 1 < slowest ? "," : "");
+    }
+    fprintf(file, "\t]\n}\n");
+}
+
+void print_time_report(FILE* file, bool json) {
+    double total = now() - origin;
+    long peak_rss = get_peak_rss();
+
+    if (functions_count > 0) {
+        qsort(measures, functions_count, sizeof(FunctionMeasure), compare_functions);
+    }
+    int slowest = functions_count < TIME_REPORT_SLOWEST ? functions_count : TIME_REPORT_SLOWEST;
+
+    if (json) {
+        print_json(file, total, peak_rss, slowest);
+    }
+    else {
+        print_text(file, total, peak_rss, slowest);
+    }
+
+    free(measures);
+    measures = NULL;
+    functions_count = 0;
+    functions_capacity = 0;
+}
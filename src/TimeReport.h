@@ -0,0 +1,36 @@
+#ifndef __TIME_REPORT__
+#define __TIME_REPORT__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "tree.h"
+
+// phases of a compilation, in the order they run
+typedef enum {
+    PHASE_PARSE,            // yyparse
+    PHASE_DECLARATIONS,     // globals and function signatures
+    PHASE_ANALYSIS,         // call graph and the passes rewriting the tree
+    PHASE_FUNCTIONS,        // semantic checks and code of each function
+    PHASE_OUTPUT,           // functions written in their layout order
+    PHASE_FREE,             // deleteTree
+    PHASES_COUNT
+} Phase;
+
+// functions listed by the report, from the slowest one
+#define TIME_REPORT_SLOWEST 10
+
+// allocations made by the compiler itself, counted by the wrappers of malloc, calloc
+// and realloc the linker substitutes with --wrap
+extern long allocations_count;
+
+void time_report_begin(void);
+void time_report_start(Phase phase);
+void time_report_stop(Phase phase);
+void time_report_function_start(void);
+void time_report_function_stop(char* name);
+void time_report_count_nodes(Node* tree);
+void time_report_count_symbols(Node* tree);
+
+void print_time_report(FILE* file, bool json);
+
+#endif
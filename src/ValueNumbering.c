@@ -0,0 +1,756 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "ValueNumbering.h"
+#include "utils.h"
+#include "stats.h"
+
+// an expression is numbered by its operator and the numbers of its operands, a variable by
+// its version, which changes with every assignment to it and, for globals, with every
+// call to a function that may assign them
+typedef struct {
+    int op;                 // label and operator, see OPERATOR
+    int left;               // numbers of the operands, -1 if none,
+    int right;              // or the value of a constant, or a variable and its version
+} Term;
+
+#define OPERATOR(label, detail) ((label) * 65536 + (detail))
+
+typedef struct {
+    int term;               // -1 for anything else than a call free expression of operators
+    int weight;             // instructions computing it again
+    bool reads_globals;
+    bool may_trap;          // divides by something else than a non zero constant
+    int index;              // creation order, the same in both passes
+    int previous;           // available value of the same term made before, -1 if none
+    char holder[64];        // variable or temporary keeping the value, empty if none
+    int holder_variable;    // its version must not have changed, -1 for a temporary
+    int holder_version;
+} Value;
+
+// a node numbered for the current statement, or for good when it was put in place of
+// an expression, it is then named like it
+typedef struct {
+    Node* node;             // NULL for a free slot
+    int stamp;              // the statement, ALIAS for a node put in place of an expression
+    Value value;
+    bool constant;
+    int constant_value;
+} Numbered;
+
+#define ALIAS -1
+
+typedef struct {
+    Node* func;
+    CallGraph* graph;
+    SymbolTable* global;
+    bool rewrite;           // second pass, the first one only counts the uses
+
+    char** names;
+    bool* globals;
+    bool* ints;             // a char variable would truncate the values assigned to it
+    int* versions;
+    int names_count;
+    int next_version;
+    int* name_slots;        // open addressing table of the indices of names, -1 when free
+    int name_slots_count;
+
+    Term* terms;
+    int terms_count;
+    int terms_capacity;
+    int* term_slots;
+    int term_slots_count;
+    int* latest;            // of each term, the last available value, -1 if none
+
+    Value* values;          // available values, those of inner blocks last
+    int values_count;
+    int values_capacity;
+    int created;
+    int* uses;              // first pass: occurrences of each created value
+    int* weights;
+    int uses_capacity;
+
+    Numbered* numbered;     // open addressing table on the node
+    int numbered_count;
+    int numbered_slots_count;
+    int stamp;              // changes whenever the versions do
+
+    Node** insert;          // before the statement, where temporaries are computed
+    bool has_call;          // in the expressions of the statement
+    bool has_writer_call;
+    bool loop_condition;    // evaluated again at each iteration, nothing is hoisted out of it
+
+    Node* temporaries;
+    int temporaries_count;
+} Numbering;
+
+// a value is worth a temporary when its uses save more than the store and the loads
+#define WORTH_TEMPORARY(uses, weight) ((uses) > 1 && (uses) * ((weight) - 1) > 2)
+
+static void* grow(void* array, int* capacity, int count, size_t size) {
+    if (count < *capacity) return array;
+
+    *capacity = *capacity == 0 ? 16 : *capacity * 2;
+    array = realloc(array, size * *capacity);
+    if (array == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    return array;
+}
+
+static void* allocate_slots(int count, size_t size) {
+    void* slots = malloc(size * count);
+    if (slots == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    return slots;
+}
+
+static unsigned int mix(unsigned int hash, unsigned int word) {
+    hash = (hash ^ word) * 0x9E3779B1u;
+    return hash ^ (hash >> 15);
+}
+
+static unsigned int name_hash(char* name) {
+    unsigned int hash = 5381;
+    for (; *name != '\0'; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash;
+}
+
+// type of the variable declared with the name, NULL if there is none
+static Node* declares(Node* declarations, char* ident) {
+    for (Node *type = declarations->firstChild; type != NULL; type = type->nextSibling) {
+        for (Node *var = type->firstChild; var != NULL; var = var->nextSibling) {
+            if (strcmp(var->ident, ident) == 0) return type;
+        }
+    }
+    return NULL;
+}
+
+static Node* get_local_type(Numbering* n, char* name) {
+    Node* type = declares(THIRDCHILD(FIRSTCHILD(n->func)), name);
+    return type != NULL ? type : declares(FIRSTCHILD(SECONDCHILD(n->func)), name);
+}
+
+// slot of the name, or the free slot where it would go
+static int find_name_slot(Numbering* n, char* name) {
+    int mask = n->name_slots_count - 1;
+    int s = name_hash(name) & mask;
+    while (n->name_slots[s] != -1 && strcmp(n->names[n->name_slots[s]], name) != 0) {
+        s = (s + 1) & mask;
+    }
+    return s;
+}
+
+static int find_variable(Numbering* n, char* name) {
+    return n->name_slots[find_name_slot(n, name)];
+}
+
+// every variable of the function is known before the walk, so versions can be copied
+static void register_variables(Numbering* n, Node* node) {
+    if (node == NULL) return;
+
+    if (node->label == function_call) {
+        register_variables(n, SECONDCHILD(node));
+        return;
+    }
+
+    if (node->label == ident && find_variable(n, node->ident) == -1) {
+        Node* local = get_local_type(n, node->ident);
+        bool global = local == NULL && table_contains(n->global, node->ident) && table_get_type(n->global, node->ident).type == TYPE_PRIMITIF;
+        if (local != NULL || global) {
+            n->names[n->names_count] = node->ident;
+            n->globals[n->names_count] = global;
+            n->ints[n->names_count] = global ? table_get_type(n->global, node->ident).primitif == TYPE_INT : strcmp(local->ident, "int") == 0;
+            n->name_slots[find_name_slot(n, node->ident)] = n->names_count;
+            n->names_count++;
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        register_variables(n, child);
+    }
+}
+
+static void kill_variable(Numbering* n, char* name) {
+    int i = find_variable(n, name);
+    if (i != -1) n->versions[i] = ++n->next_version;
+    n->stamp++;
+}
+
+static void kill_globals(Numbering* n) {
+    for (int i = 0; i < n->names_count; i++) {
+        if (n->globals[i]) n->versions[i] = ++n->next_version;
+    }
+    n->stamp++;
+}
+
+// variables a loop or a switch may have changed whenever its code is reached again
+static void kill_assigned(Numbering* n, Node* node) {
+    if (node == NULL) return;
+    if (node->label == assignment) kill_variable(n, FIRSTCHILD(node)->ident);
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        kill_assigned(n, child);
+    }
+}
+
+static int find_term_slot(Numbering* n, int op, int left, int right) {
+    int mask = n->term_slots_count - 1;
+    int s = mix(mix(mix(0, op), left), right) & mask;
+    while (n->term_slots[s] != -1) {
+        Term* term = &n->terms[n->term_slots[s]];
+        if (term->op == op && term->left == left && term->right == right) break;
+        s = (s + 1) & mask;
+    }
+    return s;
+}
+
+// number of the term, a new one the first time it is seen
+static int number_term(Numbering* n, int op, int left, int right) {
+    if (2 * (n->terms_count + 1) > n->term_slots_count) {
+        free(n->term_slots);
+        n->term_slots_count = n->term_slots_count == 0 ? 64 : n->term_slots_count * 2;
+        n->term_slots = (int*)allocate_slots(n->term_slots_count, sizeof(int));
+        memset(n->term_slots, -1, sizeof(int) * n->term_slots_count);
+        for (int t = 0; t < n->terms_count; t++) {
+            n->term_slots[find_term_slot(n, n->terms[t].op, n->terms[t].left, n->terms[t].right)] = t;
+        }
+    }
+
+    int s = find_term_slot(n, op, left, right);
+    if (n->term_slots[s] != -1) return n->term_slots[s];
+
+    n->terms = (Term*)grow(n->terms, &n->terms_capacity, n->terms_count, sizeof(Term));
+    n->latest = (int*)realloc(n->latest, sizeof(int) * n->terms_capacity);
+    if (n->latest == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    n->terms[n->terms_count] = (Term){ op, left, right };
+    n->latest[n->terms_count] = -1;
+    n->term_slots[s] = n->terms_count;
+    return n->terms_count++;
+}
+
+// slot of the node, or the free slot where it would go
+static int find_numbered_slot(Numbering* n, Node* node) {
+    int mask = n->numbered_slots_count - 1;
+    int s = mix(mix(0, (unsigned int)(size_t)node), (unsigned int)((size_t)node >> 32)) & mask;
+    while (n->numbered[s].node != NULL && n->numbered[s].node != node) {
+        s = (s + 1) & mask;
+    }
+    return s;
+}
+
+// where the numbers of the node are kept, they are set by the caller
+static Numbered* add_numbered(Numbering* n, Node* node) {
+    if (2 * (n->numbered_count + 1) > n->numbered_slots_count) {
+        Numbered* old = n->numbered;
+        int old_count = n->numbered_slots_count;
+        n->numbered_slots_count = old_count == 0 ? 256 : old_count * 2;
+        n->numbered = (Numbered*)allocate_slots(n->numbered_slots_count, sizeof(Numbered));
+        memset(n->numbered, 0, sizeof(Numbered) * n->numbered_slots_count);
+        for (int s = 0; s < old_count; s++) {
+            if (old[s].node != NULL) n->numbered[find_numbered_slot(n, old[s].node)] = old[s];
+        }
+        free(old);
+    }
+
+    Numbered* numbered = &n->numbered[find_numbered_slot(n, node)];
+    if (numbered->node == NULL) n->numbered_count++;
+    numbered->node = node;
+    return numbered;
+}
+
+// numbers the expression after its operands, once per statement
+static Numbered* number_node(Numbering* n, Node* e) {
+    if (n->numbered_slots_count > 0) {
+        Numbered* found = &n->numbered[find_numbered_slot(n, e)];
+        if (found->node == e && (found->stamp == ALIAS || found->stamp == n->stamp)) return found;
+    }
+
+    Numbered numbered;
+    memset(&numbered, 0, sizeof(Numbered));
+    Value* value = &numbered.value;
+    value->term = -1;
+    value->previous = -1;
+    value->holder_variable = -1;
+
+    switch (e->label) {
+    case num:
+    case character:
+        numbered.constant = true;
+        numbered.constant_value = e->label == num ? e->num : get_character_value(e->ident);
+        value->term = number_term(n, OPERATOR(num, 0), numbered.constant_value, -1);
+        break;
+
+    case ident: {
+        int i = find_variable(n, e->ident);
+        if (i == -1) break;
+
+        value->term = number_term(n, OPERATOR(ident, 0), i, n->versions[i]);
+        value->weight = 1;
+        value->reads_globals = n->globals[i];
+        break;
+    }
+
+    case addsub:
+    case divstar:
+    case eq:
+    case order:
+    case not:
+    case and:
+    case or: {
+        int op = OPERATOR(e->label, 0);
+        if (e->label == addsub || e->label == divstar) op = OPERATOR(e->label, (unsigned char)e->byte);
+        if (e->label == eq || e->label == order) op = OPERATOR(e->label, (unsigned char)e->comp[0] * 256 + (unsigned char)e->comp[1]);
+
+        // the numbers of the operands are copied, numbering the next one may move them
+        Numbered first = *number_node(n, FIRSTCHILD(e));
+        Numbered second;
+        memset(&second, 0, sizeof(Numbered));
+        second.constant = true;
+        second.value.term = -1;
+        if (SECONDCHILD(e) != NULL) second = *number_node(n, SECONDCHILD(e));
+
+        if (first.constant && second.constant) {
+            numbered.constant = fold_operation(e, first.constant_value, second.constant_value, &numbered.constant_value);
+        }
+        if (first.value.term == -1 || (SECONDCHILD(e) != NULL && second.value.term == -1)) break;
+
+        value->term = number_term(n, op, first.value.term, second.value.term);
+        value->weight = 1 + first.value.weight + second.value.weight;
+        value->reads_globals = first.value.reads_globals || second.value.reads_globals;
+        value->may_trap = first.value.may_trap || second.value.may_trap;
+        if (e->label == divstar && e->byte != '*') {
+            value->weight += 2;
+            if (!second.constant || second.constant_value == 0) value->may_trap = true;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    numbered.stamp = n->stamp;
+    Numbered* added = add_numbered(n, e);
+    *added = numbered;
+    added->node = e;
+    return added;
+}
+
+// name of a call free expression made of operators, -1 for anything else
+static int get_term(Numbering* n, Node* e, Value* value) {
+    Numbered* numbered = number_node(n, e);
+    *value = numbered->value;
+    value->holder[0] = '\0';
+    value->holder_variable = -1;
+
+    if (e->label == num || e->label == character || e->label == ident || numbered->constant) return -1;
+    return value->term;
+}
+
+static Value* find_value(Numbering* n, int term) {
+    for (int i = n->latest[term]; i != -1; i = n->values[i].previous) {
+        Value* value = &n->values[i];
+        if (value->holder_variable != -1 && n->versions[value->holder_variable] != value->holder_version) continue;
+        return value;
+    }
+    return NULL;
+}
+
+static Value* add_value(Numbering* n, Value* value) {
+    n->values = (Value*)grow(n->values, &n->values_capacity, n->values_count, sizeof(Value));
+    Value* added = &n->values[n->values_count];
+    *added = *value;
+    added->index = n->created++;
+    added->previous = n->latest[value->term];
+    n->latest[value->term] = n->values_count++;
+
+    n->uses = (int*)grow(n->uses, &n->uses_capacity, added->index, sizeof(int));
+    n->weights = (int*)realloc(n->weights, sizeof(int) * n->uses_capacity);
+    if (n->weights == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    if (!n->rewrite) {
+        n->uses[added->index] = 1;
+        n->weights[added->index] = value->weight;
+    }
+    return added;
+}
+
+static void drop_values(Numbering* n, int count) {
+    while (n->values_count > count) {
+        Value* value = &n->values[--n->values_count];
+        n->latest[value->term] = value->previous;
+    }
+}
+
+// the holder is named like the expression it was put in place of
+static void add_alias(Numbering* n, Node* holder, Value* value) {
+    Numbered* alias = add_numbered(n, holder);
+    alias->stamp = ALIAS;
+    alias->value = *value;
+    alias->constant = false;
+}
+
+// puts the holder of the value in place of the expression
+static void replace(Numbering* n, Node** link, Value* value) {
+    Node* e = *link;
+    Node* holder = makeNode(ident);
+    strcpy(holder->ident, value->holder);
+    holder->lineno = e->lineno;
+    holder->nextSibling = e->nextSibling;
+    *link = holder;
+
+    add_alias(n, holder, value);
+
+    e->nextSibling = NULL;
+    deleteTree(e);
+    stats.common_subexpressions++;
+}
+
+// computes the expression into a new temporary before the statement
+static void hoist(Numbering* n, Node** link, Value* value) {
+    Node* e = *link;
+
+    if (n->temporaries == NULL) {
+        n->temporaries = makeNode(type);
+        strcpy(n->temporaries->ident, "int");
+        addChild(FIRSTCHILD(SECONDCHILD(n->func)), n->temporaries);
+    }
+    Node* declared = makeNode(ident);
+    sprintf(declared->ident, ".cse%d", n->temporaries_count++);
+    addChild(n->temporaries, declared);
+    strcpy(value->holder, declared->ident);
+
+    Node* target = makeNode(ident);
+    strcpy(target->ident, declared->ident);
+    target->lineno = e->lineno;
+
+    Node* definition = makeNode(assignment);
+    definition->lineno = e->lineno;
+
+    // the expression moves to the definition, its place gets the temporary
+    Node* holder = makeNode(ident);
+    strcpy(holder->ident, declared->ident);
+    holder->lineno = e->lineno;
+    holder->nextSibling = e->nextSibling;
+    *link = holder;
+    e->nextSibling = NULL;
+
+    addChild(definition, target);
+    addChild(definition, e);
+    definition->nextSibling = *n->insert;
+    *n->insert = definition;
+    n->insert = &definition->nextSibling;
+
+    add_alias(n, holder, value);
+}
+
+// a call of the statement may change the globals read before or after it
+static bool is_reusable(Numbering* n, Value* value) {
+    return !(n->has_writer_call && value->reads_globals);
+}
+
+// computing the expression before the statement must not skip a call it follows
+static bool is_hoistable(Numbering* n, Value* value) {
+    if (n->loop_condition || !is_reusable(n, value)) return false;
+    return !(n->has_call && value->may_trap);
+}
+
+// unconditional expressions are evaluated whenever the statement is, unlike the second
+// operands of && and ||; the root of an assignment is kept by the variable instead
+static void number_expression(Numbering* n, Node** link, bool unconditional, bool assigned) {
+    Node* e = *link;
+    if (e == NULL) return;
+
+    Value value;
+    int term = get_term(n, e, &value);
+
+    if (term != -1) {
+        Value* found = find_value(n, term);
+        if (found != NULL && is_reusable(n, &value)) {
+            if (!n->rewrite) {
+                n->uses[found->index]++;
+            }
+            else if (found->holder[0] != '\0') {
+                replace(n, link, found);
+            }
+            return;
+        }
+    }
+
+    if (e->label == function_call) {
+        Node* arguments = SECONDCHILD(e);
+        if (arguments != NULL) {
+            for (Node **child = &arguments->firstChild; *child != NULL; child = &(*child)->nextSibling) {
+                number_expression(n, child, unconditional, false);
+            }
+        }
+    }
+    else {
+        bool first = true;
+        for (Node **child = &e->firstChild; *child != NULL; child = &(*child)->nextSibling) {
+            bool conditional = !first && (e->label == and || e->label == or);
+            number_expression(n, child, unconditional && !conditional, false);
+            first = false;
+        }
+    }
+
+    if (term != -1 && unconditional && !assigned && is_hoistable(n, &value) && find_value(n, term) == NULL) {
+        Value* added = add_value(n, &value);
+        if (n->rewrite && WORTH_TEMPORARY(n->uses[added->index], n->weights[added->index])) {
+            hoist(n, link, added);
+        }
+    }
+}
+
+static void set_statement(Numbering* n, Node** link, Node* expressions) {
+    n->insert = link;
+    n->has_call = call_graph_contains_call(expressions);
+    n->has_writer_call = call_graph_contains_writer_call(n->graph, n->global, expressions);
+    n->loop_condition = false;
+    n->stamp++;
+}
+
+static void number_block(Numbering* n, Node** link);
+
+// the numbers of the nodes hold while the versions do
+static void copy_versions(Numbering* n, int* to, int* from) {
+    memcpy(to, from, sizeof(int) * (n->names_count > 0 ? n->names_count : 1));
+    n->stamp++;
+}
+
+// a branch runs or not, its values are forgotten and its assignments kill after it
+static void number_branch(Numbering* n, Node** link) {
+    if (*link == NULL) return;
+
+    int values_count = n->values_count;
+    if ((*link)->label == body) {
+        number_block(n, &(*link)->firstChild);
+    }
+    else if (n->rewrite) {
+        // temporaries need a list to be computed in
+        Node* block = makeNode(body);
+        block->lineno = (*link)->lineno;
+        block->nextSibling = (*link)->nextSibling;
+        (*link)->nextSibling = NULL;
+        block->firstChild = *link;
+        *link = block;
+        number_block(n, &block->firstChild);
+    }
+    else {
+        // only the statement, its siblings belong to the if
+        Node* statement = *link;
+        Node* next = statement->nextSibling;
+        statement->nextSibling = NULL;
+        number_block(n, link);
+        statement->nextSibling = next;
+    }
+    drop_values(n, values_count);
+}
+
+static void number_if(Numbering* n, Node* instr) {
+    Node* condition = FIRSTCHILD(instr);
+    number_expression(n, &instr->firstChild, true, false);
+    if (n->has_writer_call) kill_globals(n);
+
+    Node** then_link = &condition->nextSibling;
+    Node** else_link = NULL;
+    if (*then_link != NULL && (*then_link)->label == else_) {
+        else_link = &(*then_link)->firstChild;
+        then_link = NULL;
+    }
+    else if (*then_link != NULL && (*then_link)->nextSibling != NULL) {
+        else_link = &(*then_link)->nextSibling->firstChild;
+    }
+
+    int* before = (int*)malloc(sizeof(int) * (n->names_count > 0 ? n->names_count : 1));
+    int* after_then = (int*)malloc(sizeof(int) * (n->names_count > 0 ? n->names_count : 1));
+    if (before == NULL || after_then == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    copy_versions(n, before, n->versions);
+
+    if (then_link != NULL) number_branch(n, then_link);
+    copy_versions(n, after_then, n->versions);
+    copy_versions(n, n->versions, before);
+    if (else_link != NULL) number_branch(n, else_link);
+
+    // where the branches join, a variable assigned in either has a new value
+    for (int i = 0; i < n->names_count; i++) {
+        if (after_then[i] != before[i] || n->versions[i] != before[i]) {
+            n->versions[i] = ++n->next_version;
+        }
+    }
+    n->stamp++;
+
+    free(before);
+    free(after_then);
+}
+
+static void number_while(Numbering* n, Node* instr) {
+    // the condition is reached again after the body
+    Node* loop_body = SECONDCHILD(instr);
+    kill_assigned(n, loop_body);
+    if (call_graph_contains_writer_call(n->graph, n->global, instr)) kill_globals(n);
+
+    n->loop_condition = true;
+    number_expression(n, &instr->firstChild, true, false);
+    n->loop_condition = false;
+    if (n->has_writer_call) kill_globals(n);
+
+    int* head = (int*)malloc(sizeof(int) * (n->names_count > 0 ? n->names_count : 1));
+    if (head == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    copy_versions(n, head, n->versions);
+
+    // a body without braces is not a list of instructions
+    if (loop_body != NULL && loop_body->label == body) {
+        int values_count = n->values_count;
+        number_block(n, &loop_body->firstChild);
+        drop_values(n, values_count);
+    }
+
+    // the loop leaves from its condition
+    copy_versions(n, n->versions, head);
+    free(head);
+}
+
+static Node** number_statement(Numbering* n, Node** link) {
+    Node* instr = *link;
+
+    switch (instr->label) {
+    case assignment: {
+        Node* var = FIRSTCHILD(instr);
+        set_statement(n, link, SECONDCHILD(instr));
+
+        Value value;
+        int term = get_term(n, SECONDCHILD(instr), &value);
+        bool reused = term != -1 && find_value(n, term) != NULL && is_reusable(n, &value);
+        number_expression(n, &var->nextSibling, true, true);
+
+        if (n->has_writer_call) kill_globals(n);
+        kill_variable(n, var->ident);
+
+        // the variable keeps the value until either changes
+        int i = find_variable(n, var->ident);
+        if (term != -1 && !reused && i != -1 && n->ints[i] && !n->has_writer_call) {
+            strcpy(value.holder, var->ident);
+            value.holder_variable = i;
+            value.holder_version = n->versions[i];
+            add_value(n, &value);
+        }
+        break;
+    }
+
+    case function_call:
+        set_statement(n, link, instr);
+        number_expression(n, link, true, false);
+        if (n->has_writer_call) kill_globals(n);
+        break;
+
+    case return_:
+        set_statement(n, link, FIRSTCHILD(instr));
+        if (FIRSTCHILD(instr) != NULL) {
+            number_expression(n, &instr->firstChild, true, false);
+        }
+        break;
+
+    case if_:
+        set_statement(n, link, FIRSTCHILD(instr));
+        number_if(n, instr);
+        break;
+
+    case while_:
+        set_statement(n, link, FIRSTCHILD(instr));
+        number_while(n, instr);
+        break;
+
+    case switch_:
+        // cases fall through one another, only the value switched on is numbered
+        set_statement(n, link, FIRSTCHILD(instr));
+        number_expression(n, &instr->firstChild, true, false);
+        kill_assigned(n, SECONDCHILD(instr));
+        if (call_graph_contains_writer_call(n->graph, n->global, instr)) kill_globals(n);
+        break;
+
+    case body:
+        number_block(n, &instr->firstChild);
+        break;
+
+    default:
+        break;
+    }
+
+    // temporaries were inserted before the statement
+    return &instr->nextSibling;
+}
+
+static void number_block(Numbering* n, Node** link) {
+    while (*link != NULL) {
+        link = number_statement(n, link);
+    }
+}
+
+static void number_function(Numbering* n) {
+    memset(n->versions, 0, sizeof(int) * (n->names_count > 0 ? n->names_count : 1));
+    n->next_version = 0;
+    drop_values(n, 0);
+    n->created = 0;
+
+    number_block(n, &SECONDCHILD(SECONDCHILD(n->func))->firstChild);
+}
+
+void eliminate_common_subexpressions(Node* func, CallGraph* graph, SymbolTable* global) {
+    Numbering n;
+    memset(&n, 0, sizeof(Numbering));
+    n.func = func;
+    n.graph = graph;
+    n.global = global;
+
+    int size = count_nodes(func);
+    n.names = (char**)malloc(sizeof(char*) * size);
+    n.globals = (bool*)malloc(sizeof(bool) * size);
+    n.ints = (bool*)malloc(sizeof(bool) * size);
+    n.versions = (int*)malloc(sizeof(int) * size);
+    if (n.names == NULL || n.globals == NULL || n.ints == NULL || n.versions == NULL) {
+        perror("ValueNumbering");
+        exit(3);
+    }
+    n.name_slots_count = 16;
+    while (n.name_slots_count < 2 * size) n.name_slots_count *= 2;
+    n.name_slots = (int*)allocate_slots(n.name_slots_count, sizeof(int));
+    memset(n.name_slots, -1, sizeof(int) * n.name_slots_count);
+    register_variables(&n, SECONDCHILD(SECONDCHILD(func)));
+
+    number_function(&n);
+    n.rewrite = true;
+    number_function(&n);
+
+    free(n.numbered);
+    free(n.terms);
+    free(n.term_slots);
+    free(n.latest);
+    free(n.values);
+    free(n.uses);
+    free(n.weights);
+    free(n.names);
+    free(n.globals);
+    free(n.ints);
+    free(n.versions);
+    free(n.name_slots);
+}
@@ -0,0 +1,12 @@
+#ifndef __VALUE_NUMBERING__
+#define __VALUE_NUMBERING__
+
+#include "tree.h"
+#include "SymbolTable.h"
+#include "CallGraph.h"
+
+// reuses the values of expressions computed earlier on every path,
+// through the variable assigned with them or a hidden temporary
+void eliminate_common_subexpressions(Node* func, CallGraph* graph, SymbolTable* global);
+
+#endif
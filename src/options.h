@@ -0,0 +1,25 @@
+#ifndef __OPTIONS__
+#define __OPTIONS__
+
+#include <stdbool.h>
+
+typedef struct {
+    int optimize;           // 0 disables every optimization
+    int inline_budget;      // number of AST nodes the inliner may duplicate
+    bool inline_report;     // print every inlined call on stderr
+    bool stats;             // print the optimization counters on stderr
+    bool standard_calls;    // every function follows System V, no internal convention
+    char* instrument;       // profile the program writes at exit, NULL when it counts nothing
+    char* profile_use;      // profile read back to guide the optimizations, NULL without one
+    bool profile_functions; // the program times its functions and reports them at exit
+    char* function_report;  // file of that report, NULL for stderr
+    bool profile_leaves;    // small leaves are timed too instead of counting in their caller
+    bool time_report;       // print the time and allocations of each phase on stderr
+    bool time_report_json;  // the same report in JSON
+    bool codegen_stats;     // report the code generated for each function
+    char* codegen_report;   // file of that report, NULL for stderr
+} Options;
+
+extern Options options;
+
+#endif
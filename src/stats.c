@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+#include "Peephole.h"
+
+Stats stats = {0};
+
+static FunctionStats* functions_stats = NULL;
+static int functions_stats_count = 0;
+static int functions_stats_capacity = 0;
+
+void print_stats(FILE* file) {
+    fprintf(file, 
+        "stats:\n"
+        "\ttail calls: %d\n"
+        "\tself tail calls: %d\n"
+        "\taccumulator functions: %d\n"
+        "\tdead functions removed: %d\n"
+        "\tfully inlined functions removed: %d\n"
+        "\tdead globals removed: %d\n"
+        "\tleaf functions without frame: %d\n"
+        "\tprologue bytes saved: %d\n"
+        "\tinternal calling conventions: %d\n"
+        "\texpressions in registers: %d\n"
+        "\tcommon subexpressions reused: %d\n"
+        "\tconstants and copies propagated: %d\n"
+        "\tconstant branches removed: %d\n"
+        "\tdead stores removed: %d\n"
+        "\tstack bytes saved: %d\n"
+        "\tbuiltin fast paths: %d\n"
+        "\tbranches inverted by the profile: %d\n"
+        "\tloops rotated by the profile: %d\n"
+        "\tswitches ordered by the profile: %d\n",
+        stats.tail_calls,
+        stats.self_tail_calls,
+        stats.accumulator_functions,
+        stats.dead_functions,
+        stats.inlined_functions,
+        stats.dead_globals,
+        stats.leaf_functions,
+        stats.prologue_bytes_saved,
+        stats.custom_conventions,
+        stats.register_expressions,
+        stats.common_subexpressions,
+        stats.propagated_values,
+        stats.constant_branches,
+        stats.dead_stores,
+        stats.stack_bytes_saved,
+        stats.builtin_fast_paths,
+        stats.inverted_branches,
+        stats.rotated_loops,
+        stats.profiled_switches
+    );
+    print_peephole_stats(file);
+}
+
+void add_function_stats(FunctionStats* function) {
+    if (functions_stats_count == functions_stats_capacity) {
+        functions_stats_capacity = functions_stats_capacity == 0 ? 16 : functions_stats_capacity * 2;
+        functions_stats = (FunctionStats*)realloc(functions_stats, sizeof(FunctionStats) * functions_stats_capacity);
+        if (functions_stats == NULL) {
+            perror("add_function_stats");
+            exit(3);
+        }
+    }
+    functions_stats[functions_stats_count++] = *function;
+}
+
+void set_function_emitted(char* name) {
+    for (int i = 0; i < functions_stats_count; i++) {
+        if (strcmp(functions_stats[i].name, name) == 0) functions_stats[i].emitted = true;
+    }
+}
+
+// one line per function in the order of the source, tab separated under a header,
+// so that two versions of the compiler can be compared with diff
+void print_function_stats(FILE* file) {
+    fprintf(file, "function\tinstructions\tstack\tloads\tstores\tbranches\tcalls\tdivisions\tmax_stack_depth\tframe_size\tlabels\temitted\n");
+    for (int i = 0; i < functions_stats_count; i++) {
+        FunctionStats* f = &functions_stats[i];
+        fprintf(file, "%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+            f->name,
+            f->instructions,
+            f->stack,
+            f->loads,
+            f->stores,
+            f->branches,
+            f->calls,
+            f->divisions,
+            f->max_stack_depth,
+            f->frame_size,
+            f->labels,
+            f->emitted ? 1 : 0
+        );
+    }
+
+    free(functions_stats);
+    functions_stats = NULL;
+    functions_stats_count = 0;
+    functions_stats_capacity = 0;
+}
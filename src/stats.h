@@ -0,0 +1,53 @@
+#ifndef __STATS__
+#define __STATS__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+typedef struct {
+    int tail_calls;             // return f(...) compiled into a jump
+    int self_tail_calls;        // return f(...) inside f, compiled into a loop
+    int accumulator_functions;  // return x op f(...) turned into an accumulator loop
+    int dead_functions;         // functions unreachable from main
+    int inlined_functions;      // reachable functions whose calls were all inlined
+    int dead_globals;           // globals no reachable function uses
+    int leaf_functions;         // functions compiled without frame pointer
+    int prologue_bytes_saved;   // frame setup, teardown and parameter spills avoided
+    int custom_conventions;     // functions taking their arguments in registers of their own
+    int register_expressions;   // expressions evaluated in registers, heavier operand first
+    int common_subexpressions;  // computations replaced by a value kept from an earlier one
+    int propagated_values;      // variable reads replaced by a constant or the variable copied
+    int constant_branches;      // if and while whose condition is known, one side left out
+    int dead_stores;            // assignments to locals never read afterwards
+    int stack_bytes_saved;      // frame bytes of unused locals and of slots shared by disjoint lifetimes
+    int builtin_fast_paths;     // getchar and putchar calls compiled against the runtime buffers
+    int inverted_branches;      // if whose else ran more often in the profile, laid out first
+    int rotated_loops;          // while tested at the bottom, iterating more than once per entry in the profile
+    int profiled_switches;      // switch testing its cases from the most frequent one in the profile
+} Stats;
+
+// the code of a function once through the peephole optimizer, for --codegen-stats
+typedef struct {
+    char name[64];
+    int instructions;
+    int stack;                  // push, pop and moves to the slots of the expression stack
+    int loads;                  // other instructions reading memory
+    int stores;                 // other instructions writing memory
+    int branches;               // jmp and conditional jumps
+    int calls;
+    int divisions;              // idiv and div
+    int max_stack_depth;        // deepest expression stack, in bytes
+    int frame_size;             // bytes of the locals, inlined ones included
+    int labels;
+    bool emitted;               // false when every call was inlined
+} FunctionStats;
+
+extern Stats stats;
+
+void print_stats(FILE* file);
+
+void add_function_stats(FunctionStats* function);
+void set_function_emitted(char* name);
+void print_function_stats(FILE* file);
+
+#endif
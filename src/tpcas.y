@@ -11,6 +11,10 @@
 #include "tree.h"
 #include "SymbolTable.h"
 #include "utils.h"
+#include "options.h"
+#include "stats.h"
+#include "Profile.h"
+#include "TimeReport.h"
 
 void yyerror(const char *);
 int yylex();
@@ -22,6 +26,36 @@ bool print_tree = false;
 bool print_tables = false;
 Node* tree = NULL;
 
+Options options = {
+    .optimize = 1,
+    .inline_budget = 400,
+    .inline_report = false,
+    .stats = false,
+    .standard_calls = false,
+    .instrument = NULL,
+    .profile_use = NULL,
+    .profile_functions = false,
+    .function_report = NULL,
+    .profile_leaves = false,
+    .time_report = false,
+    .time_report_json = false,
+    .codegen_stats = false,
+    .codegen_report = NULL,
+};
+
+enum {
+    OPT_INLINE_BUDGET = 256,
+    OPT_INLINE_REPORT,
+    OPT_STATS,
+    OPT_STANDARD_CALLS,
+    OPT_INSTRUMENT,
+    OPT_PROFILE_USE,
+    OPT_PROFILE_FUNCTIONS,
+    OPT_PROFILE_LEAVES,
+    OPT_TIME_REPORT,
+    OPT_CODEGEN_STATS,
+};
+
 %}
 
 %token INVALID_SYMBOL
@@ -432,6 +466,18 @@ ListExp:
 void print_usage() {
     printf("Usage: ./tpcas [OPTION] [FILE.tpc]\n\
     -t, --tree affiche l’arbre abstrait sur la sortie standard\n\
+    -s, --symtabs affiche les tables des symboles avec l’arbre\n\
+    -O0, -O1 désactive (0) ou active (1, par défaut) les optimisations\n\
+    --inline-budget=N nombre de noeuds que l’inlining peut dupliquer (400 par défaut)\n\
+    --inline-report affiche les appels remplacés par le corps de la fonction\n\
+    --stats affiche les compteurs des optimisations sur la sortie d’erreur\n\
+    --standard-calls toutes les fonctions suivent la convention d’appel System V\n\
+    --instrument[=FICHIER] le programme compte ses blocs et ses appels et les écrit en sortant (tpc.profile par défaut)\n\
+    --profile-use=FICHIER utilise ces comptes pour disposer le code et choisir les appels à remplacer\n\
+    --profile-functions[=FICHIER] le programme mesure les cycles de ses fonctions et les écrit en sortant (sortie d’erreur par défaut)\n\
+    --profile-leaves mesure aussi les petites fonctions feuilles, dont les cycles sont sinon comptés dans l’appelant\n\
+    --time-report[=json] affiche le temps et les allocations de chaque phase de la compilation sur la sortie d’erreur\n\
+    --codegen-stats[=FICHIER] décompte les instructions générées pour chaque fonction (sortie d’erreur par défaut)\n\
     -h, --help affiche une description de l’interface utilisateur et termine l’exécution\n");
 }
 
@@ -457,13 +503,65 @@ int main(int argc, char* argv[]) {
         {"tree", optional_argument, NULL, 't'},
         {"symtabs", optional_argument, NULL, 's'},
         {"help", optional_argument, NULL, 'h'},
+        {"inline-budget", required_argument, NULL, OPT_INLINE_BUDGET},
+        {"inline-report", no_argument, NULL, OPT_INLINE_REPORT},
+        {"stats", no_argument, NULL, OPT_STATS},
+        {"standard-calls", no_argument, NULL, OPT_STANDARD_CALLS},
+        {"instrument", optional_argument, NULL, OPT_INSTRUMENT},
+        {"profile-use", required_argument, NULL, OPT_PROFILE_USE},
+        {"profile-functions", optional_argument, NULL, OPT_PROFILE_FUNCTIONS},
+        {"profile-leaves", no_argument, NULL, OPT_PROFILE_LEAVES},
+        {"time-report", optional_argument, NULL, OPT_TIME_REPORT},
+        {"codegen-stats", optional_argument, NULL, OPT_CODEGEN_STATS},
         {0, 0, 0, 0},
     };
 
+    time_report_begin();
+
     int opt;
 
-    while ((opt = getopt_long(argc, argv, "tsh", long_options, NULL )) != -1) {
+    while ((opt = getopt_long(argc, argv, "tshO:", long_options, NULL )) != -1) {
         switch (opt) {
+            case 'O':
+                options.optimize = atoi(optarg);
+                break;
+            case OPT_INLINE_BUDGET:
+                options.inline_budget = atoi(optarg);
+                break;
+            case OPT_INLINE_REPORT:
+                options.inline_report = true;
+                break;
+            case OPT_STATS:
+                options.stats = true;
+                break;
+            case OPT_STANDARD_CALLS:
+                options.standard_calls = true;
+                break;
+            case OPT_INSTRUMENT:
+                options.instrument = optarg != NULL ? optarg : PROFILE_FILE;
+                break;
+            case OPT_PROFILE_USE:
+                options.profile_use = optarg;
+                break;
+            case OPT_PROFILE_FUNCTIONS:
+                options.profile_functions = true;
+                options.function_report = optarg;
+                break;
+            case OPT_PROFILE_LEAVES:
+                options.profile_leaves = true;
+                break;
+            case OPT_TIME_REPORT:
+                options.time_report = true;
+                if (optarg != NULL && strcmp(optarg, "json") != 0) {
+                    fprintf(stderr, "--time-report: unknown format %s\n", optarg);
+                    return 2;
+                }
+                options.time_report_json = optarg != NULL;
+                break;
+            case OPT_CODEGEN_STATS:
+                options.codegen_stats = true;
+                options.codegen_report = optarg;
+                break;
             case 't': 
                 print_tree = true;
                 break;
@@ -483,8 +581,11 @@ int main(int argc, char* argv[]) {
         write_file_to_stdin(path);
     }      
 
+    time_report_start(PHASE_PARSE);
 	int value = yyparse();
+    time_report_stop(PHASE_PARSE);
     if (tree == NULL || value != 0) return value;
+    time_report_count_nodes(tree);
 
     FILE* file = fopen("bin/_anonymous.asm", "w");
     if (file == NULL) {
@@ -493,13 +594,38 @@ int main(int argc, char* argv[]) {
     }
 
     compile_prog(tree, file);
+    time_report_start(PHASE_OUTPUT);
     fclose(file);
+    time_report_stop(PHASE_OUTPUT);
+
+    if (options.stats) {
+        print_stats(stderr);
+    }
+
+    if (options.codegen_stats) {
+        FILE* report = options.codegen_report != NULL ? fopen(options.codegen_report, "w") : stderr;
+        if (report == NULL) {
+            perror("Cannot open file");
+            exit(3);
+        }
+        print_function_stats(report);
+        if (report != stderr) {
+            fclose(report);
+        }
+    }
 
     if (print_tree) {
         printTree(tree, print_tables);
     }
 
+    time_report_count_symbols(tree);
+    time_report_start(PHASE_FREE);
     deleteTree(tree);
+    time_report_stop(PHASE_FREE);
+
+    if (options.time_report) {
+        print_time_report(stderr, options.time_report_json);
+    }
     return value;
 }
 
@@ -54,6 +54,7 @@ Node *makeNode(label_t label) {
   node-> firstChild = node->nextSibling = NULL;
   node->lineno=yylineno;
   node->sym_table = NULL;
+  node->profile = -1;
   return node;
 }
 
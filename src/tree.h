@@ -56,6 +56,7 @@ typedef struct Node {
     char comp[3];
   };
   SymbolTable* sym_table;
+  int profile;  /* first counter of the node in the profile, -1 if it has none */
 } Node;
 
 Node *makeNode(label_t label);
@@ -1,127 +1,824 @@
 ; utils.asm
+; the runtime of TPC programs, it stands alone: programs are linked without libc
+BUFFER_SIZE equ 65536
+
 section .data
-    format_registers db "rbx:0x%lx r12:0x%lx r13:%ld r14:%ld", 10, 0
-    format_stack db "sommet (rsp): 0x%lx, base du bloc (rbp): 0x%lx", 10, 0
-    format_int db "%d", 10, 0
+    text_rbx db "rbx:0x", 0
+    text_r12 db " r12:0x", 0
+    text_r13 db " r13:", 0
+    text_r14 db " r14:", 0
+    text_rsp db "sommet (rsp): 0x", 0
+    text_rbp db ", base du bloc (rbp): 0x", 0
+    hex_digits db "0123456789abcdef"
+    text_profile db "tpc-profile ", 0
+    text_function_header db "calls               inclusive cycles    exclusive cycles    exclusive %  function", 10, 0
+    align 8
+    ; multipliers of the digits read at once by getint
+    powers_of_ten dq 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+    ; the two digits of 0 to 99
+    digit_pairs db "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899"
+
+section .bss
+    ; bytes written by putchar and putint, sent by _flush
+    _output_buffer resb BUFFER_SIZE
+    _output_length resq 1
+    ; file descriptor _flush writes to, minus 1 so that stdout is zero
+    output_fd resq 1
+
+    ; bytes of stdin not read yet, from _input_position to _input_end
+    input_buffer resb BUFFER_SIZE
+    _input_position resq 1
+    _input_end resq 1
+    ; 0 before the first read, 1 reading with read, 2 reading a mapped file
+    input_state resq 1
+    stat_buffer resb 144
+
+    ; functions entered and not left yet under --profile-functions: their record,
+    ; the time stamp at their entry, the cycles of their callees and the calls they
+    ; made to themselves not left yet; deeper calls are only counted, their cycles go
+    ; to the last function on the stack; the profiled functions push themselves,
+    ; PROFILE_DEPTH of utils.c is the same
+    PROFILE_DEPTH equ 65536
+    ; below the first entry, what the outermost function gives to its caller
+    profile_bottom resq 4
+    _profile_stack resq 4 * PROFILE_DEPTH
+    _profile_depth resq 1
 
 section .text
 global show_registers
 global show_stack
-extern getchar
-extern putchar
+global getchar
+global putchar
 global getint
 global putint
-extern printf
+global _flush
+global _exit_program
+global _write_profile
+global _profile_stack
+global _profile_depth
+global _profile_exit
+global _write_function_profile
+; the compiler reads and writes the buffers in place for getchar and putchar
+global _output_buffer
+global _output_length
+global _input_position
+global _input_end
+
+; rbx, r12 and r13, r14 in hexadecimal then in decimal, on the standard output
 show_registers:
-    push rbp
-    mov rbp, rsp
-    
-    mov r8,  r14
-    mov rcx, r13
-    mov rdx, r12
-    mov rsi, rbx
-    mov rdi, format_registers
-    mov rax, 0
-    call printf 
-        
-    pop rbp
-    ret
+    call _output_room
+    mov rsi, text_rbx
+    call _append_string
+    mov rax, rbx
+    call _append_hex
+    mov rsi, text_r12
+    call _append_string
+    mov rax, r12
+    call _append_hex
+    mov rsi, text_r13
+    call _append_string
+    mov rax, r13
+    call _append_signed
+    mov rsi, text_r14
+    call _append_string
+    mov rax, r14
+    call _append_signed
+    mov byte [rdi], 10
+    inc rdi
+    jmp _output_commit
 
+; rsp and rbp of the caller, on the standard output
 show_stack:
-    push rbp
-    mov rbp, rsp
+    call _output_room
+    mov rsi, text_rsp
+    call _append_string
+    lea rax, [rsp + 8]
+    call _append_hex
+    mov rsi, text_rbp
+    call _append_string
+    mov rax, rbp
+    call _append_hex
+    mov byte [rdi], 10
+    inc rdi
+    jmp _output_commit
+
+; rdi: where to write in the output buffer, with room for a line of the show functions
+; or of a report
+_output_room:
+    mov rax, qword [_output_length]
+    cmp rax, BUFFER_SIZE - 256
+    jb _output_room_ret
+    call _flush
+    xor eax, eax
+
+    _output_room_ret:
+        lea rdi, [_output_buffer + rax]
+    ret
+
+; rdi: end of what was written in the output buffer
+_output_commit:
+    mov rax, _output_buffer
+    sub rdi, rax
+    mov qword [_output_length], rdi
+    ret
+
+; rsi: string ended by a zero, copied at rdi
+_append_string:
+    mov al, byte [rsi]
+    test al, al
+    jz _append_string_ret
+    mov byte [rdi], al
+    inc rsi
+    inc rdi
+    jmp _append_string
+
+    _append_string_ret:
+    ret
+
+; rax: written at rdi in hexadecimal, without leading zeros
+_append_hex:
+    mov ecx, 1
+    test rax, rax
+    jz _append_hex_digits
+    bsr rcx, rax
+    shr ecx, 2
+    inc ecx
+
+    _append_hex_digits:
+        add rdi, rcx
+        mov rsi, rdi
+
+    _append_hex_loop:
+        mov edx, eax
+        and edx, 15
+        movzx edx, byte [hex_digits + rdx]
+        dec rsi
+        mov byte [rsi], dl
+        shr rax, 4
+        dec ecx
+        jnz _append_hex_loop
+    ret
+
+; rax: written at rdi in decimal
+_append_signed:
+    test rax, rax
+    jns _append_signed_digits
+    mov byte [rdi], '-'
+    inc rdi
+    neg rax
+
+    ; the digits are written backwards below rsp, then copied
+    _append_signed_digits:
+        lea rsi, [rsp - 1]
+        mov r8d, 10
+
+    _append_signed_loop:
+        xor edx, edx
+        div r8
+        add dl, '0'
+        mov byte [rsi], dl
+        dec rsi
+        test rax, rax
+        jnz _append_signed_loop
+
+    _append_signed_copy:
+        inc rsi
+        cmp rsi, rsp
+        jae _append_signed_ret
+        mov al, byte [rsi]
+        mov byte [rdi], al
+        inc rdi
+        jmp _append_signed_copy
+
+    _append_signed_ret:
+    ret
+
+; the builtins only use caller-saved registers, syscall itself changes rcx and r11
+
+; writes the whole output buffer to stdout
+_flush:
+    mov rsi, _output_buffer
+    mov rdx, qword [_output_length]
+
+    _flush_loop:
+        test rdx, rdx
+        jz _flush_ret
+
+        mov eax, 1
+        mov rdi, qword [output_fd]
+        inc edi
+        syscall
+
+        ; a closed output loses what is left
+        test rax, rax
+        jle _flush_ret
+
+        add rsi, rax
+        sub rdx, rax
+        jmp _flush_loop
+
+    _flush_ret:
+        mov qword [_output_length], 0
+    ret
+
+; edi: exit status, the output is flushed first
+_exit_program:
+    push rdi
+    call _flush
+    pop rdi
+
+    mov eax, 60
+    syscall
+
+; rdi: counters of an instrumented program, esi: their count, rdx: path of the file
+; written with a header and one count per line, ecx: shape of the tree, in the header
+_write_profile:
+    push r12
+    push r13
+    push r14
+    mov r12, rdi
+    mov r13d, esi
+    mov r14d, ecx
+    mov rdi, rdx
+    call _redirect_output
+    test rax, rax
+    js _write_profile_ret
+
+    call _output_room
+    mov rsi, text_profile
+    call _append_string
+    mov eax, r13d
+    call _append_signed
+    mov byte [rdi], ' '
+    inc rdi
+    mov eax, r14d
+    call _append_signed
+    mov byte [rdi], 10
+    inc rdi
+    call _output_commit
+
+    _write_profile_loop:
+        test r13d, r13d
+        jz _write_profile_close
+        call _output_room
+        mov rax, qword [r12]
+        call _append_signed
+        mov byte [rdi], 10
+        inc rdi
+        call _output_commit
+        add r12, 8
+        dec r13d
+        jmp _write_profile_loop
+
+    _write_profile_close:
+        call _restore_output
+
+    _write_profile_ret:
+    pop r14
+    pop r13
+    pop r12
+    ret
+
+; the function on top of the profile stack leaves by a tail call, every register is kept;
+; the same as the code a profiled function returns through
+_profile_exit:
+    push rax
+    push rcx
+    push rdx
+    push rsi
+    mov rcx, qword [_profile_depth]
+    cmp rcx, PROFILE_DEPTH
+    ja _profile_exit_full
+    shl rcx, 5
+    cmp qword [_profile_stack + rcx - 8], 0
+    jne _profile_exit_nested
+
+    dec qword [_profile_depth]
+    lea rcx, [_profile_stack + rcx - 32]
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    sub rax, qword [rcx + 8]
+    mov rdx, rax
+    sub rdx, qword [rcx + 16]
+    mov rsi, qword [rcx]
+    add qword [rsi + 16], rdx
+    dec qword [rsi + 24]
+    jnz _profile_exit_caller
+    add qword [rsi + 8], rax
+
+    _profile_exit_caller:
+        add qword [rcx - 16], rax
+        jmp _profile_exit_ret
+
+    _profile_exit_nested:
+        dec qword [_profile_stack + rcx - 8]
+        jmp _profile_exit_ret
+
+    _profile_exit_full:
+        dec qword [_profile_depth]
+
+    _profile_exit_ret:
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rax
+    ret
+
+; rdi: records of the functions, esi: their count, rdx: their names, rcx: path of the
+; report, stderr when 0; from the most exclusive cycles down, functions never entered
+; are left out
+_write_function_profile:
+    push rbx
+    push r12
+    push r13
+    push r14
+    push r15
+    mov r12, rdi
+    mov r13d, esi
+    mov r14, rdx
+    mov rdi, rcx
+    call _redirect_output
+    test rax, rax
+    js _write_function_profile_ret
+
+    xor r15d, r15d
+    xor ecx, ecx
+
+    _write_function_profile_total:
+        cmp ecx, r13d
+        jae _write_function_profile_header
+        mov rax, rcx
+        shl rax, 5
+        add r15, qword [r12 + rax + 16]
+        inc ecx
+        jmp _write_function_profile_total
+
+    ; the base of the percentages, never 0
+    _write_function_profile_header:
+        test r15, r15
+        jnz _write_function_profile_title
+        inc r15
+
+    _write_function_profile_title:
+        call _output_room
+        mov rsi, text_function_header
+        call _append_string
+        call _output_commit
 
-    mov rdx, [rsp]
-    mov rax, rsp
-    add rax, 16
-    mov rsi, rax
-    mov rdi, format_stack
-    mov rax, 0
-    call printf WRT ..plt
-    
-    pop rbp
+    ; the records left have no activation, a printed one gets one
+    _write_function_profile_row:
+        mov rbx, -1
+        xor ecx, ecx
+
+    _write_function_profile_scan:
+        cmp ecx, r13d
+        jae _write_function_profile_scanned
+        mov rsi, rcx
+        shl rsi, 5
+        add rsi, r12
+        cmp qword [rsi], 0
+        je _write_function_profile_next
+        cmp qword [rsi + 24], 0
+        jne _write_function_profile_next
+        test rbx, rbx
+        js _write_function_profile_take
+        mov rax, rbx
+        shl rax, 5
+        mov rax, qword [r12 + rax + 16]
+        cmp qword [rsi + 16], rax
+        jbe _write_function_profile_next
+
+    _write_function_profile_take:
+        mov rbx, rcx
+
+    _write_function_profile_next:
+        inc ecx
+        jmp _write_function_profile_scan
+
+    _write_function_profile_scanned:
+        test rbx, rbx
+        js _write_function_profile_close
+        mov rax, rbx
+        shl rax, 5
+        mov qword [r12 + rax + 24], 1
+
+        call _output_room
+        mov rax, rbx
+        shl rax, 5
+        mov rax, qword [r12 + rax]
+        call _append_column
+        mov rax, rbx
+        shl rax, 5
+        mov rax, qword [r12 + rax + 8]
+        call _append_column
+        mov rax, rbx
+        shl rax, 5
+        mov rax, qword [r12 + rax + 16]
+        call _append_column
+
+        ; tenths of a percent
+        push rdi
+        mov rax, rbx
+        shl rax, 5
+        mov rax, qword [r12 + rax + 16]
+        imul rax, rax, 1000
+        xor edx, edx
+        div r15
+        xor edx, edx
+        mov ecx, 10
+        div rcx
+        push rdx
+        call _append_signed
+        pop rdx
+        mov byte [rdi], '.'
+        add dl, '0'
+        mov byte [rdi + 1], dl
+        add rdi, 2
+        pop rcx
+        add rcx, 13
+        call _append_spaces
+
+        mov rsi, qword [r14 + rbx * 8]
+        call _append_string
+        mov byte [rdi], 10
+        inc rdi
+        call _output_commit
+        jmp _write_function_profile_row
+
+    _write_function_profile_close:
+        call _restore_output
+
+    _write_function_profile_ret:
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbx
     ret
 
-; getchar:
-;     push rbp
-;     mov rbp, rsp
+; rax: written at rdi in decimal, left in a column of 20 bytes
+_append_column:
+    lea rcx, [rdi + 20]
+    push rcx
+    call _append_signed
+    pop rcx
+
+; spaces from rdi to rcx
+_append_spaces:
+    cmp rdi, rcx
+    jae _append_spaces_ret
+    mov byte [rdi], ' '
+    inc rdi
+    jmp _append_spaces
+
+    _append_spaces_ret:
+    ret
+
+; rdi: file the output goes to from now on, created or emptied, stderr when 0;
+; rax is negative when it cannot be opened
+_redirect_output:
+    push rdi
+    call _flush
+    pop rdi
+
+    ; stderr and the open system call are both 2
+    mov eax, 2
+    test rdi, rdi
+    jz _redirect_output_fd
+
+    ; O_WRONLY | O_CREAT | O_TRUNC, rw-r--r--
+    mov esi, 0x241
+    mov edx, 420
+    syscall
+    test rax, rax
+    js _redirect_output_ret
+
+    _redirect_output_fd:
+        dec rax
+        mov qword [output_fd], rax
+
+    _redirect_output_ret:
+    ret
+
+; the output goes back to stdout, a file opened by _redirect_output is closed
+_restore_output:
+    call _flush
+    mov rdi, qword [output_fd]
+    inc rdi
+    mov qword [output_fd], 0
+    cmp rdi, 2
+    jbe _restore_output_ret
+    mov eax, 3
+    syscall
+
+    _restore_output_ret:
+    ret
+
+; refills the input, eax = 0 at the end of stdin
+_fill_input:
+    cmp qword [input_state], 0
+    jne _fill_input_read
+    mov qword [input_state], 1
+
+    ; a regular file is mapped whole, from the current offset of stdin
+    mov eax, 5
+    xor edi, edi
+    mov rsi, stat_buffer
+    syscall
+    test rax, rax
+    jnz _fill_input_read
+
+    mov eax, dword [stat_buffer + 24]
+    and eax, 0xf000
+    cmp eax, 0x8000
+    jne _fill_input_read
+    cmp qword [stat_buffer + 48], 0
+    je _fill_input_read
+
+    mov eax, 8
+    xor edi, edi
+    xor esi, esi
+    mov edx, 1
+    syscall
+    test rax, rax
+    js _fill_input_read
+    mov qword [_input_position], rax
+
+    mov eax, 9
+    xor edi, edi
+    mov rsi, qword [stat_buffer + 48]
+    mov edx, 1
+    mov r10d, 2
+    xor r8d, r8d
+    xor r9d, r9d
+    syscall
+    cmp rax, -4096
+    ja _fill_input_read
 
-;     sub rsp, 8
+    add qword [_input_position], rax
+    add rax, qword [stat_buffer + 48]
+    mov qword [_input_end], rax
+    mov qword [input_state], 2
 
-;     mov rax, 0
-;     mov rdi, 0
-;     mov rsi, rsp
-;     mov rdx, 1
-;     syscall
+    mov rax, qword [_input_position]
+    cmp rax, qword [_input_end]
+    jae _fill_input_eof
+    mov eax, 1
+    ret
+
+    _fill_input_read:
+        cmp qword [input_state], 2
+        je _fill_input_eof
 
-;     pop rax
+        xor eax, eax
+        xor edi, edi
+        mov rsi, input_buffer
+        mov edx, BUFFER_SIZE
+        syscall
+        test rax, rax
+        jle _fill_input_eof
 
-;     mov rsp, rbp
-;     pop rbp
-;     ret
+        mov rsi, input_buffer
+        mov qword [_input_position], rsi
+        add rsi, rax
+        mov qword [_input_end], rsi
+        mov eax, 1
+        ret
 
-; putchar:
-;     push rbp
-;     mov rbp, rsp
+    _fill_input_eof:
+        xor eax, eax
+    ret
 
-;     push rdi
+; eax: next byte of stdin, -1 at its end
+getchar:
+    mov rax, qword [_input_position]
+    cmp rax, qword [_input_end]
+    jb _getchar_byte
 
-;     mov rax, 1
-;     mov rdi, 1
-;     mov rsi, rsp
-;     mov rdx, 1
-;     syscall
+    call _fill_input
+    test eax, eax
+    jz _getchar_eof
+    mov rax, qword [_input_position]
 
-;     pop rax
+    _getchar_byte:
+        movzx ecx, byte [rax]
+        inc rax
+        mov qword [_input_position], rax
+        mov eax, ecx
+        ret
 
-;     mov rsp, rbp
-;     pop rbp
-;     ret
+    _getchar_eof:
+        mov eax, -1
+    ret
 
+; dil: byte to write
+putchar:
+    mov rax, qword [_output_length]
+    mov byte [_output_buffer + rax], dil
+    inc rax
+    mov qword [_output_length], rax
+    cmp rax, BUFFER_SIZE
+    je _flush
+    ret
+
+; eax: number read on stdin after blanks and a sign, the byte ending it is consumed
 getint:
-    push rbp
-    mov rbp, rsp
+    push rbx
+    push r12
+    xor ebx, ebx
+    xor r12d, r12d
+
+    _getint_blank:
+        call getchar
+        cmp eax, ' '
+        je _getint_blank
+        lea ecx, [rax - 9]
+        cmp ecx, 4
+        jbe _getint_blank
+
+        cmp eax, '+'
+        je _getint_sign
+        cmp eax, '-'
+        jne _getint_first
+        mov r12d, 1
+
+    _getint_sign:
+        call getchar
 
-    sub rsp, 16
-    ; number = rbp - 8
-    ; digit = rbp - 16
+    _getint_first:
+        sub eax, '0'
+        cmp eax, 9
+        ja _getint_ret
+        mov ebx, eax
 
-    mov qword [rbp - 8], 0
+    ; up to eight digits are converted at once, the masks stay in r8 to r11
+    _getint_digits:
+        mov rsi, qword [_input_position]
+        mov rdx, qword [_input_end]
+        mov r8, 0xf0f0f0f0f0f0f0f0
+        mov r9, 0x3030303030303030
+        mov r10, 0x0606060606060606
+        mov r11, 0x00ff00ff00ff00ff
 
     _getint_loop:
-        call getchar
-        mov qword [rbp - 16], rax
+        lea rax, [rsi + 8]
+        cmp rax, rdx
+        ja _getint_byte
+
+        ; a byte is a digit when it is at most 9 once '0' is removed,
+        ; the lowest other byte gives the count of digits
+        mov rax, qword [rsi]
+        xor rax, r9
+        lea rcx, [rax + r10]
+        or rcx, rax
+        and rcx, r8
+        mov edi, 64
+        bsf rcx, rcx
+        cmovz ecx, edi
+        and ecx, -8
+        jz _getint_byte
+        mov edi, ecx
+
+        ; the digits move to the top, zeros lead them; the first digit is the
+        ; lowest byte: pairs, then fours, then the eight
+        neg ecx
+        add ecx, 64
+        shl rax, cl
+        mov rcx, rax
+        shr rcx, 8
+        imul rax, rax, 10
+        add rax, rcx
+        and rax, r11
+        mov rcx, rax
+        shr rcx, 16
+        imul rax, rax, 100
+        add rax, rcx
+        mov rcx, 0x0000ffff0000ffff
+        and rax, rcx
+        mov rcx, rax
+        shr rcx, 32
+        imul rax, rax, 10000
+        add rax, rcx
+        mov eax, eax
 
-        cmp qword [rbp - 16], '0'
-        jl _getint_ret
-        cmp qword [rbp - 16], '9'
-        jg _getint_ret
+        shr edi, 3
+        imul rbx, qword [powers_of_ten + rdi * 8]
+        add rbx, rax
+        add rsi, rdi
+        cmp edi, 8
+        je _getint_loop
 
-        sub qword [rbp - 16], '0'
-        mov rax, qword [rbp - 8]
-        imul rax, 10
-        add rax, qword [rbp - 16]
-        mov qword [rbp - 8], rax
+        ; the byte after the digits ends the number
+        inc rsi
+        jmp _getint_end
 
+    _getint_byte:
+        cmp rsi, rdx
+        jae _getint_refill
+
+        movzx eax, byte [rsi]
+        inc rsi
+        sub eax, '0'
+        cmp eax, 9
+        ja _getint_end
+
+        lea rbx, [rbx + rbx * 4]
+        lea rbx, [rax + rbx * 2]
         jmp _getint_loop
 
+    _getint_refill:
+        mov qword [_input_position], rsi
+        call _fill_input
+        test eax, eax
+        jnz _getint_digits
+        jmp _getint_ret
+
+    _getint_end:
+        mov qword [_input_position], rsi
+
     _getint_ret:
-        mov rax, qword [rbp - 8]
+        mov eax, ebx
+        test r12d, r12d
+        jz _getint_positive
+        neg eax
 
-    mov rsp, rbp
-    pop rbp
+    _getint_positive:
+    pop r12
+    pop rbx
     ret
 
+; edi: number written in decimal, followed by a newline, two digits at a time
 putint:
-    push rbp
-    mov rbp, rsp
-
+    ; room for a sign, ten digits and the newline; the buffer is never left full,
+    ; putchar stores before checking
+    mov rax, qword [_output_length]
+    cmp rax, BUFFER_SIZE - 12
+    jb _putint_room
     push rdi
+    call _flush
+    pop rdi
+    xor eax, eax
 
-    mov rdi, format_int
-    pop rsi
-    call printf 
+    _putint_room:
+        lea rsi, [_output_buffer + rax]
+        mov eax, edi
+        test eax, eax
+        jns _putint_count_start
+        mov byte [rsi], '-'
+        inc rsi
+        neg eax
+
+    ; eax is unsigned from here, -2147483648 included
+    _putint_count_start:
+        mov r8d, 1
+        mov edx, 10
 
-    mov rsp, rbp
-    pop rbp
-    ret
\ No newline at end of file
+    _putint_count:
+        cmp eax, edx
+        jb _putint_counted
+        inc r8d
+        cmp r8d, 10
+        je _putint_counted
+        lea edx, [rdx + rdx * 4]
+        add edx, edx
+        jmp _putint_count
+
+    _putint_counted:
+        add rsi, r8
+        mov byte [rsi], 10
+        mov rdi, rsi
+
+    ; eax / 100 is the high part of eax * 0x51eb851f shifted by 37
+    _putint_pairs:
+        cmp eax, 100
+        jb _putint_last
+        mov ecx, eax
+        mov edx, 0x51eb851f
+        imul rdx, rcx
+        shr rdx, 37
+        imul r8d, edx, 100
+        sub ecx, r8d
+        mov eax, edx
+        movzx ecx, word [digit_pairs + rcx * 2]
+        sub rdi, 2
+        mov word [rdi], cx
+        jmp _putint_pairs
+
+    _putint_last:
+        cmp eax, 10
+        jb _putint_digit
+        movzx ecx, word [digit_pairs + rax * 2]
+        mov word [rdi - 2], cx
+        jmp _putint_done
+
+    _putint_digit:
+        add eax, '0'
+        mov byte [rdi - 1], al
+
+    _putint_done:
+        inc rsi
+        mov rax, _output_buffer
+        sub rsi, rax
+        mov qword [_output_length], rsi
+    ret
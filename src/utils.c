@@ -5,13 +5,68 @@
 #include <tree.h>
 
 #include "utils.h"
+#include "options.h"
+#include "stats.h"
+#include "Peephole.h"
+#include "Convention.h"
+#include "ValueNumbering.h"
+#include "ConstantPropagation.h"
+#include "Liveness.h"
+#include "Profile.h"
+#include "TimeReport.h"
 
 extern char* StringFromLabel[];
 
 static int stack_alignment = 0;
+static int max_stack_depth = 0;    // deepest expression stack of the function being compiled
+static int inline_budget = 0;
+static int inline_depth = 0;
+static int current_function = 0;   // index in the call graph of the function being compiled
+static int loop_depth = 0;
+static int holding_registers[2];   // keep the intermediate results of an expression besides eax
+static int holding_count = 0;
+static int profile_counters = 0;   // counters of the instrumented program
+static int profiled_functions = 0; // records of --profile-functions, one per function of the call graph
+
+static bool call_graph_layout_contains(int* order, int count, int index) {
+    for (int i = 0; i < count; i++) {
+        if (order[i] == index) return true;
+    }
+    return false;
+}
+
+// the weights of a caller are summed, they must not overflow
+#define PROFILE_MAX_WEIGHT (1 << 20)
+
+// calls inside loops are expected to run more often, unless the profile tells
+static void record_call(Tables* tables, char* name, Node* call) {
+    int callee = call_graph_index(tables->call_graph, tables->global, name);
+    if (callee == -1) return;
+
+    int weight = 1;
+    if (profile_loaded()) {
+        long long count = profile_count(call, PROFILE_EXECUTIONS);
+        weight = count < PROFILE_MAX_WEIGHT ? (int)count : PROFILE_MAX_WEIGHT;
+    }
+    else {
+        for (int i = 0; i < loop_depth && i < 4; i++) {
+            weight *= 8;
+        }
+    }
+    call_graph_add_call(tables->call_graph, current_function, callee, weight);
+}
+
+// the counters are incremented where the flags hold nothing
+static void compile_counter(FILE* file, Node* node, int counter) {
+    if (options.instrument == NULL || node->profile == -1) return;
+    fprintf(file, "\tinc qword [_profile_counters + %d]\n", (node->profile + counter) * 8);
+}
 
 static void insert_stack(FILE* file, int bytes) {
     stack_alignment += bytes;
+    if (stack_alignment > max_stack_depth) {
+        max_stack_depth = stack_alignment;
+    }
     fprintf(file, "\t; stack: %d\n", stack_alignment);
 }
 
@@ -23,32 +78,129 @@ static void pop_stack(FILE* file) {
     insert_stack(file, -8);
 }
 
-static int get_required_alignment() {
-    int tmp = stack_alignment % 16;
-    return tmp == 0 ? 0 : 16 - tmp;
+// slot of the expression stack value at the given depth, above the outgoing arguments
+static void get_stack_slot(Tables* tables, int depth, char buffer[40]) {
+    sprintf(buffer, "qword [rsp + %d]", tables->outgoing_size + depth - 8);
+}
+
+// a leaf really pushes, a function making calls keeps rsp still so that
+// every call finds it aligned and its expression stack lives in the frame
+static void push_value(FILE* file, Tables* tables, char* value) {
+    if (tables->leaf) {
+        fprintf(file, "\tpush %s\n", value);
+    }
+    else {
+        char slot[40];
+        get_stack_slot(tables, stack_alignment + 8, slot);
+        fprintf(file, "\tmov %s, %s\n", slot, value);
+    }
+    push_stack(file);
+}
+
+static void push_number(FILE* file, Tables* tables, int value) {
+    char buffer[16];
+    sprintf(buffer, "%d", value);
+    push_value(file, tables, buffer);
+}
+
+static void pop_value(FILE* file, Tables* tables, char* reg) {
+    if (tables->leaf) {
+        fprintf(file, "\tpop %s\n", reg);
+    }
+    else {
+        char slot[40];
+        get_stack_slot(tables, stack_alignment, slot);
+        fprintf(file, "\tmov %s, %s\n", reg, slot);
+    }
+    pop_stack(file);
+}
+
+// reads the top of the expression stack without popping it, no depth comment
+// follows so the peephole optimizer does not take it for a pop
+static void peek_value(FILE* file, Tables* tables, char* reg) {
+    if (tables->leaf) {
+        fprintf(file, "\tmov %s, qword [rsp]\n", reg);
+    }
+    else {
+        char slot[40];
+        get_stack_slot(tables, stack_alignment, slot);
+        fprintf(file, "\tmov %s, %s\n", reg, slot);
+    }
+}
+
+// pushes 1 when the jump to label_true is taken, 0 otherwise
+static void push_condition(FILE* file, Tables* tables, char label_true[25], char label_false[25]) {
+    push_value(file, tables, "0");
+    fprintf(file, 
+        "\tjmp %s\n"
+        "\t%s:\n",
+        label_false,
+        label_true
+    );
+
+    // the other branch fills the same slot
+    pop_stack(file);
+    push_value(file, tables, "1");
+    fprintf(file, "\t%s:\n", label_false);
+}
+
+static int max_call_arguments(Node* node) {
+    int max = 0;
+    if (node->label == function_call && SECONDCHILD(node) != NULL) {
+        for (Node *child = SECONDCHILD(node)->firstChild; child != NULL; child = child->nextSibling) {
+            max++;
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        int n = max_call_arguments(child);
+        if (n > max) max = n;
+    }
+    return max;
 }
 
+static int labels_count = 0;
+
 void get_new_label(char buffer[25]) {
-    static int count = 0;
+    sprintf(buffer, "__label_%d", labels_count);
+    labels_count++;
+}
 
-    sprintf(buffer, "__label_%d", count);
-    count++;
+// address of the next variable of this size, aligned on its size
+static int next_address(SymbolTable* table, int size) {
+    table->size = (table->size + size + size - 1) / size * size;
+    return table->size;
 }
 
 void fillSymbolTable(SymbolTable* table, Node* declarations) {
+    int start = table->size;
     for (Node *child = declarations->firstChild; child != NULL; child = child->nextSibling) {
         Type var_type;
         var_type.type = TYPE_PRIMITIF;
         var_type.primitif = get_primitif_from_string(child->ident);
         insertDeclType(table, var_type, child);
     }
+
+    // larger types first, the chars fill the frame without padding
+    table->size = start;
+    for (int size = 4; size >= 1; size /= 2) {
+        for (Node *child = declarations->firstChild; child != NULL; child = child->nextSibling) {
+            Type var_type;
+            var_type.type = TYPE_PRIMITIF;
+            var_type.primitif = get_primitif_from_string(child->ident);
+            if (get_type_size(var_type) != size) continue;
+
+            for (Node *var = child->firstChild; var != NULL; var = var->nextSibling) {
+                table_get_symbol(table, var->ident)->address = next_address(table, size);
+            }
+        }
+    }
 }
 
 void insertDeclType(SymbolTable* table, Type var_type, Node* node) {
     for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
-        table->size += get_type_size(var_type);
         Symbol* symbol = new_symbol(var_type, child->ident);
-        symbol->address = table->size;
+        symbol->address = next_address(table, get_type_size(var_type));
         bool inserted = insert_symbol(table, symbol);
         if (!inserted) {
             fprintf(stderr, "Line %d: Variable %s already declared\n", child->lineno, child->ident);
@@ -74,6 +226,7 @@ int get_type_size(Type type) {
 
     switch (type.primitif) {
     case TYPE_CHAR:
+        return 1;
     case TYPE_INT:
         return 4;
     default:
@@ -84,7 +237,16 @@ int get_type_size(Type type) {
 void get_string_address(Tables* tables, char* value, char buffer[25]) {
     if (table_contains(tables->local, value)) {
         int address = table_get_address(tables->local, value);
-        sprintf(buffer, "rbp - %d", address);
+        if (tables->leaf) {
+            // rsp moved by the frame and by every push since the prologue
+            sprintf(buffer, "rsp + %d", tables->frame_size + stack_alignment - address);
+        }
+        else if (address < 0) {
+            sprintf(buffer, "rbp + %d", -address);
+        }
+        else {
+            sprintf(buffer, "rbp - %d", address);
+        }
         return;
     }
     if (table_contains(tables->global, value)) {
@@ -97,27 +259,114 @@ void get_string_address(Tables* tables, char* value, char buffer[25]) {
 }
 
 
+// calls cost a prologue, an epilogue and the moves of the arguments
+#define INLINE_CALL_COST 12
+#define INLINE_MAX_SIZE 200
+#define INLINE_MAX_DEPTH 8
+
+static bool should_inline(Tables* tables, CallGraphNode* callee, int args_count, Node* call) {
+    if (callee == NULL || callee->recursive) return false;
+    if (strcmp(callee->name, "main") == 0) return false;
+    if (callee->size > inline_budget || inline_depth >= INLINE_MAX_DEPTH) return false;
+
+    // small bodies are cheaper than the call, a single call site does not duplicate code
+    int benefit = INLINE_CALL_COST + 2 * args_count;
+    if (callee->size <= benefit) return true;
+
+    // a call that never ran in the profile only grows its caller,
+    // one running more often than its caller pays for the copy
+    if (profile_loaded()) {
+        Node* caller = call_graph_get(tables->call_graph, tables->global, tables->function_name)->function;
+        long long calls = profile_count(call, PROFILE_EXECUTIONS);
+        long long entries = profile_count(caller, PROFILE_EXECUTIONS);
+        if (calls == 0 && entries != 0) return false;
+        if (calls > entries) return callee->size <= INLINE_MAX_SIZE;
+    }
+
+    return callee->call_sites == 1 && callee->size <= INLINE_MAX_SIZE;
+}
+
+
+// operand of a variable: its register or its memory location
+void get_variable_operand(Tables* tables, char* value, char buffer[40]) {
+    if (table_contains(tables->local, value)) {
+        Symbol* symbol = table_get_symbol(tables->local, value);
+        if (symbol->reg != NULL) {
+            strcpy(buffer, symbol->reg);
+            return;
+        }
+    }
+
+    Type type = get_type(tables, value);
+    char address[25];
+    get_string_address(tables, value, address);
+    sprintf(buffer, "%s [%s]", type.primitif == TYPE_CHAR ? "byte" : "dword", address);
+}
+
+// a char is stored as a signed byte, it is sign extended when read
+void load_variable(FILE* file, Tables* tables, char* value, char* target) {
+    char buffer[40];
+    get_variable_operand(tables, value, buffer);
+    bool byte = strncmp(buffer, "byte", 4) == 0;
+    fprintf(file, "\t%s %s, %s\n", byte ? "movsx" : "mov", target, buffer);
+}
+
+// source is a 32 bits register, a char keeps its low byte even in a register
+void store_variable(FILE* file, Tables* tables, char* value, char* source) {
+    char buffer[40];
+    get_variable_operand(tables, value, buffer);
+
+    Type type = get_type(tables, value);
+    if (type.primitif != TYPE_CHAR) {
+        fprintf(file, "\tmov %s, %s\n", buffer, source);
+        return;
+    }
+
+    char* low = byte_register_name(register_from_name(source));
+    if (register_from_name(buffer) != -1) {
+        fprintf(file, "\tmovsx %s, %s\n", buffer, low);
+    }
+    else {
+        fprintf(file, "\tmov %s, %s\n", buffer, low);
+    }
+}
+
 void compile_global_declarations(Node* declarations, FILE* file, SymbolTable* table) {
-    fprintf(file, "section .data\n");
-    
-    for (Node *child = declarations->firstChild; child != NULL; child = child->nextSibling) {
-        Type var_type;
-        var_type.type = TYPE_PRIMITIF;
-        var_type.primitif = get_primitif_from_string(child->ident);
-        compile_global_declaration(child, file, var_type);
-        insertDeclType(table, var_type, child);
+    // globals start at zero, the loader maps them without storing them in the binary;
+    // ints come first, keeping their alignment without padding
+    fprintf(file, "section .bss\n");
+
+    for (int size = 4; size >= 1; size /= 2) {
+        for (Node *child = declarations->firstChild; child != NULL; child = child->nextSibling) {
+            Type var_type;
+            var_type.type = TYPE_PRIMITIF;
+            var_type.primitif = get_primitif_from_string(child->ident);
+            if (get_type_size(var_type) == size) {
+                compile_global_declaration(child, file, var_type, table);
+            }
+        }
     }
 
     fprintf(file, "\n");
 }
 
-void compile_global_declaration(Node* declaration, FILE* file, Type var_type) {
+void compile_global_declaration(Node* declaration, FILE* file, Type var_type, SymbolTable* table) {
     for (Node *child = declaration->firstChild; child != NULL; child = child->nextSibling) {
+        // globals no reachable function reads or writes are dropped
+        if (options.optimize > 0 && !table_get_symbol(table, child->ident)->referenced) {
+            stats.dead_globals++;
+            continue;
+        }
+
         switch (var_type.primitif) {
         case TYPE_CHAR:
+            fprintf(file,
+                "\t%s resb 1\n", child->ident
+            );
+            break;
         case TYPE_INT:
             fprintf(file,
-                "\t%s dd 0\n", child->ident
+                "\t%s resd 1\n", child->ident
             );
             break;
         default:
@@ -126,6 +375,226 @@ void compile_global_declaration(Node* declaration, FILE* file, Type var_type) {
     }
 }
 
+// a path given on the command line, in bytes: it may hold any character
+static void compile_path(FILE* file, char* label, char* path) {
+    fprintf(file, "\t%s db ", label);
+    for (char* c = path; *c != '\0'; c++) {
+        fprintf(file, "%d, ", (unsigned char)*c);
+    }
+    fprintf(file, "0\n");
+}
+
+// the counts, and the path of the file the runtime writes them to when main returns
+static void compile_profile_data(FILE* file) {
+    fprintf(file,
+        "section .bss\n"
+        "\t_profile_counters resq %d\n\n"
+        "section .data\n",
+        profile_counters > 0 ? profile_counters : 1
+    );
+    compile_path(file, "_profile_path", options.instrument);
+    fprintf(file, "\n");
+}
+
+// without optimizations every function is written, unreachable ones included
+static bool is_emitted_function(CallGraph* graph, int i) {
+    return options.optimize == 0 || graph->nodes[i].reachable;
+}
+
+// calls, inclusive and exclusive cycles and activations of each function, updated by the
+// profiled functions themselves, then their names for the report
+static void compile_function_profile_data(FILE* file, CallGraph* graph) {
+    profiled_functions = graph->count;
+    fprintf(file,
+        "section .bss\n"
+        "\t_function_profile resq %d\n\n"
+        "section .data\n"
+        "\t_function_names dq ",
+        graph->count > 0 ? graph->count * 4 : 1
+    );
+    // a function left out is never called, the report skips it without reading its name
+    for (int i = 0; i < graph->count; i++) {
+        if (is_emitted_function(graph, i)) {
+            fprintf(file, "%s_function_name_%d", i == 0 ? "" : ", ", i);
+        }
+        else {
+            fprintf(file, "%s0", i == 0 ? "" : ", ");
+        }
+    }
+    fprintf(file, "%s\n", graph->count == 0 ? "0" : "");
+    for (int i = 0; i < graph->count; i++) {
+        if (is_emitted_function(graph, i)) {
+            fprintf(file, "\t_function_name_%d db \"%s\", 0\n", i, graph->nodes[i].name);
+        }
+    }
+    if (options.function_report != NULL) {
+        compile_path(file, "_function_report", options.function_report);
+    }
+    fprintf(file, "\n");
+}
+
+// depth of the profile stack of the runtime, see utils.asm; deeper calls are only counted
+#define PROFILE_DEPTH 65536
+
+// a leaf of at most this many nodes has its cycles charged to its caller, timing it
+// would mostly measure the profiling; --profile-leaves times it anyway
+#define PROFILE_SMALL_LEAF 64
+
+static bool is_profiled(Tables* tables) {
+    if (!options.profile_functions) return false;
+    CallGraphNode* node = &tables->call_graph->nodes[current_function];
+    return options.profile_leaves || !tables->leaf || node->size > PROFILE_SMALL_LEAF;
+}
+
+// pushes the record of the function on the profile stack of the runtime with the time
+// stamp of its entry, or only counts the activation on the top entry when it is the
+// function's own: a direct recursion is timed once; rdtsc writes rax and rdx, rdx is
+// kept when a parameter arrives in it
+static void compile_profile_enter(FILE* file, Tables* tables, Node* parameters, const int* incoming) {
+    if (!is_profiled(tables)) return;
+
+    bool keeps_rdx = false;
+    int j = 0;
+    for (Node *child = parameters->firstChild; child != NULL && j < 6; child = child->nextSibling, j++) {
+        if (incoming[j] == REG_RDX) keeps_rdx = true;
+    }
+
+    char label_nested[25];
+    char label_full[25];
+    char label_entered[25];
+    get_new_label(label_nested);
+    get_new_label(label_full);
+    get_new_label(label_entered);
+    int record = current_function * 32;
+    fprintf(file,
+        "\tinc qword [_function_profile + %d]\n"
+        "\tmov rax, qword [_profile_depth]\n"
+        "\tcmp rax, %d\n"
+        "\tjae %s\n"
+        "\tshl rax, 5\n"
+        "\tcmp qword [_profile_stack + rax - 32], _function_profile + %d\n"
+        "\tje %s\n"
+        "\tinc qword [_profile_depth]\n"
+        "\tinc qword [_function_profile + %d]\n"
+        "\tmov qword [_profile_stack + rax], _function_profile + %d\n"
+        "\tmov qword [_profile_stack + rax + 16], 0\n"
+        "\tmov qword [_profile_stack + rax + 24], 0\n",
+        record, PROFILE_DEPTH, label_full, record, label_nested, record + 24, record
+    );
+    if (keeps_rdx) {
+        fprintf(file, "\tmov r11, rdx\n");
+    }
+    fprintf(file,
+        "\trdtsc\n"
+        "\tshl rdx, 32\n"
+        "\tor rax, rdx\n"
+        "\tmov rdx, qword [_profile_depth]\n"
+        "\tshl rdx, 5\n"
+        "\tmov qword [_profile_stack + rdx - 24], rax\n"
+    );
+    if (keeps_rdx) {
+        fprintf(file, "\tmov rdx, r11\n");
+    }
+    fprintf(file,
+        "\tjmp %s\n"
+        "%s:\n"
+        "\tinc qword [_profile_stack + rax - 8]\n"
+        "\tjmp %s\n"
+        "%s:\n"
+        "\tinc qword [_profile_depth]\n"
+        "%s:\n",
+        label_entered, label_nested, label_entered, label_full, label_entered
+    );
+}
+
+// pops the function from the profile stack when it returns, eax holds the returned value
+// and the other scratch registers are free; inclusive cycles are only counted by the
+// outermost activation of a recursion, the entry below adds them to the cycles of its callees
+static void compile_profile_exit(FILE* file, Tables* tables) {
+    if (!is_profiled(tables)) return;
+
+    char label_nested[25];
+    char label_full[25];
+    char label_outer[25];
+    char label_left[25];
+    get_new_label(label_nested);
+    get_new_label(label_full);
+    get_new_label(label_outer);
+    get_new_label(label_left);
+    int record = current_function * 32;
+    fprintf(file,
+        "\tmov r11, rax\n"
+        "\tmov rcx, qword [_profile_depth]\n"
+        "\tcmp rcx, %d\n"
+        "\tja %s\n"
+        "\tshl rcx, 5\n"
+        "\tcmp qword [_profile_stack + rcx - 8], 0\n"
+        "\tjne %s\n"
+        "\tdec qword [_profile_depth]\n"
+        "\tlea rcx, [_profile_stack + rcx - 32]\n"
+        "\trdtsc\n"
+        "\tshl rdx, 32\n"
+        "\tor rax, rdx\n"
+        "\tsub rax, qword [rcx + 8]\n"
+        "\tmov rdx, rax\n"
+        "\tsub rdx, qword [rcx + 16]\n"
+        "\tadd qword [_function_profile + %d], rdx\n"
+        "\tdec qword [_function_profile + %d]\n"
+        "\tjnz %s\n"
+        "\tadd qword [_function_profile + %d], rax\n"
+        "%s:\n"
+        "\tadd qword [rcx - 16], rax\n"
+        "\tjmp %s\n"
+        "%s:\n"
+        "\tdec qword [_profile_stack + rcx - 8]\n"
+        "\tjmp %s\n"
+        "%s:\n"
+        "\tdec qword [_profile_depth]\n"
+        "%s:\n"
+        "\tmov rax, r11\n",
+        PROFILE_DEPTH, label_full, label_nested, record + 16, record + 24, label_outer, record + 8,
+        label_outer, label_left, label_nested, label_left, label_full, label_left
+    );
+}
+
+// before a tail call the arguments of the callee are in their registers, the runtime keeps them
+static void compile_profile_tail_exit(FILE* file, Tables* tables) {
+    if (!is_profiled(tables)) return;
+    fprintf(file, "\tcall _profile_exit\n");
+}
+
+static bool is_declared_in(Node* declarations, char* ident) {
+    for (Node *type = declarations->firstChild; type != NULL; type = type->nextSibling) {
+        for (Node *var = type->firstChild; var != NULL; var = var->nextSibling) {
+            if (strcmp(var->ident, ident) == 0) return true;
+        }
+    }
+    return false;
+}
+
+static void mark_referenced_globals(Node* node, Node* func, SymbolTable* global) {
+    if (node == NULL) return;
+
+    if (node->label == function_call) {
+        mark_referenced_globals(SECONDCHILD(node), func, global);
+        return;
+    }
+
+    if (node->label == ident) {
+        Node* parameters = THIRDCHILD(FIRSTCHILD(func));
+        Node* declarations = FIRSTCHILD(SECONDCHILD(func));
+
+        if (!is_declared_in(parameters, node->ident) && !is_declared_in(declarations, node->ident)) {
+            Symbol* symbol = table_get_symbol(global, node->ident);
+            if (symbol != NULL) symbol->referenced = true;
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        mark_referenced_globals(child, func, global);
+    }
+}
+
 void compile_declarations(Node* declarations, FILE* file, Tables* tables) {
     Type funct;
     funct.type = TYPE_FUNCTION;
@@ -149,7 +618,23 @@ void compile_declarations(Node* declarations, FILE* file, Tables* tables) {
     funct.function.return_type = TYPE_VOID;
     insert_symbol(tables->global, new_symbol(funct, "putint"));
 
-    compile_global_declarations(declarations, file, tables->global);
+    // emitted once the reachable functions are known
+    fillSymbolTable(tables->global, declarations);
+}
+
+// no call survives in the code of the function, self tail calls become jumps
+static bool compiles_to_leaf(Tables* tables, CallGraphNode* node) {
+    if (options.optimize == 0) return false;
+
+    Type t = table_get_type(tables->global, node->name);
+    if (t.function.args_count > 6) return false;
+
+    Node* instructions = SECONDCHILD(SECONDCHILD(node->function));
+    char accumulator = 0;
+    if (t.function.return_type != TYPE_VOID) {
+        accumulator = find_accumulator(instructions, node->name);
+    }
+    return is_leaf(instructions, node->name, accumulator);
 }
 
 void compile_prog(Node* tree, FILE* file) {
@@ -158,18 +643,19 @@ void compile_prog(Node* tree, FILE* file) {
     // define globals 
     tree->sym_table = new_table();
     tables.global = tree->sym_table;
-
+    tables.local = NULL;
+    tables.function_name = NULL;
+    tables.return_label = NULL;
+    tables.return_stack = 0;
+    tables.body_label = NULL;
+    tables.accumulator = 0;
+    tables.leaf = false;
+    tables.frame_size = 0;
+    tables.outgoing_size = 0;
+
+    time_report_start(PHASE_DECLARATIONS);
     compile_declarations(FIRSTCHILD(tree), file, &tables);
 
-    fprintf(file, 
-        "section .text\n"
-        "\textern getchar\n"
-        "\textern putchar\n"
-        "\textern getint\n"
-        "\textern putint\n"
-        "\tglobal _start\n"
-    );
-
     Node* functions = SECONDCHILD(tree);
     declare_functions(functions, &tables);
 
@@ -190,12 +676,90 @@ void compile_prog(Node* tree, FILE* file) {
         fprintf(stderr, "Program should contains a main function\n");
         exit(2);
     }
+    time_report_stop(PHASE_DECLARATIONS);
+
+    time_report_start(PHASE_ANALYSIS);
+
+    // counters are numbered on the tree as parsed, the passes below change it
+    profile_counters = number_profile_counters(functions);
+    if (options.profile_use != NULL) {
+        load_profile(options.profile_use, profile_counters);
+    }
+
+    tables.call_graph = new_call_graph(functions, tables.global);
+
+    // arguments past the sixth are stored at the bottom of the caller frame,
+    // inlining can move any call into any function so the area is sized for the program
+    int max_arguments = max_call_arguments(functions);
+    tables.outgoing_size = max_arguments > 6 ? (max_arguments - 6) * 8 : 0;
+    inline_budget = options.optimize > 0 ? options.inline_budget : 0;
+
+    CallGraph* graph = tables.call_graph;
+    call_graph_mark_reachable(graph, call_graph_index(graph, tables.global, "main"));
+
+    if (options.optimize > 0) {
+        call_graph_mark_global_writers(graph);
+        propagate_constants(graph, tables.global);
+        for (int i = 0; i < graph->count; i++) {
+            if (graph->nodes[i].reachable) {
+                eliminate_common_subexpressions(graph->nodes[i].function, graph, tables.global);
+                eliminate_dead_stores(graph->nodes[i].function, tables.global);
+            }
+        }
+    }
+
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].reachable || options.optimize == 0) {
+            mark_referenced_globals(SECONDCHILD(graph->nodes[i].function), graph->nodes[i].function, tables.global);
+        }
+    }
+
+    // callers need the registers of their callees before any code is generated
+    for (int i = 0; i < graph->count; i++) {
+        graph->nodes[i].leaf = compiles_to_leaf(&tables, &graph->nodes[i]);
+    }
+    assign_conventions(graph, options.optimize > 0 && !options.standard_calls);
+    time_report_stop(PHASE_ANALYSIS);
+
+    time_report_start(PHASE_OUTPUT);
+    compile_global_declarations(FIRSTCHILD(tree), file, tables.global);
+    if (options.instrument != NULL) {
+        compile_profile_data(file);
+    }
+    if (options.profile_functions) {
+        compile_function_profile_data(file, graph);
+    }
+
+    fprintf(file, 
+        "section .text\n"
+        "\textern getchar\n"
+        "\textern putchar\n"
+        "\textern getint\n"
+        "\textern putint\n"
+        "\textern _exit_program\n"
+        "\textern _flush\n"
+        "\textern _output_buffer\n"
+        "\textern _output_length\n"
+        "\textern _input_position\n"
+        "\textern _input_end\n"
+        "\textern _write_profile\n"
+        "\textern _profile_exit\n"
+        "\textern _profile_stack\n"
+        "\textern _profile_depth\n"
+        "\textern _write_function_profile\n"
+        "\tglobal _start\n"
+    );
+    time_report_stop(PHASE_OUTPUT);
 
     compile_functions(functions, file, &tables);
+
+    free_call_graph(tables.call_graph);
+    free_profile();
 }
 
 void declare_functions(Node* functions, Tables* tables) {
-    for (Node *func = functions->firstChild; func != NULL; func = func->nextSibling) {
+    int index = 0;
+    for (Node *func = functions->firstChild; func != NULL; func = func->nextSibling, index++) {
         // define function
         Node* header = FIRSTCHILD(func);
         Node* function_name = SECONDCHILD(header);
@@ -219,7 +783,11 @@ void declare_functions(Node* functions, Tables* tables) {
         }
         funct.function.args_count = count;
 
-        bool inserted = insert_symbol(tables->global, new_symbol(funct, function_name->ident));
+        // the address of a function is its index in the call graph
+        Symbol* symbol = new_symbol(funct, function_name->ident);
+        symbol->address = index;
+
+        bool inserted = insert_symbol(tables->global, symbol);
         if (!inserted) {
             fprintf(stderr, "Line %d: Function %s already declared\n", func->lineno, function_name->ident);
             exit(2);
@@ -227,97 +795,376 @@ void declare_functions(Node* functions, Tables* tables) {
     }
 }
 
-void compile_functions(Node* functions, FILE* file, Tables* tables) {
-    for (Node *child = functions->firstChild; child != NULL; child = child->nextSibling) {
-        stack_alignment = 0; // reset stack
-        compile_function(child, file, tables);
+// a function unreachable from main is still checked, then thrown away with what compiling it recorded
+static void compile_dead_function(Node* func, Tables* tables) {
+    char* buffer = NULL;
+    size_t size = 0;
+    FILE* scratch = open_memstream(&buffer, &size);
+    if (scratch == NULL) {
+        perror("open_memstream");
+        exit(3);
     }
-}
 
-void compile_function(Node* func, FILE* file, Tables* tables) {
-    // define function
-    Node* header = FIRSTCHILD(func);
-    Node* function_name = SECONDCHILD(header);
-    Node* parameters = THIRDCHILD(header);
+    Stats saved_stats = stats;
+    int saved_budget = inline_budget;
+    int saved_labels = labels_count;
+    int saved_calls = tables->call_graph->nodes[current_function].calls_count;
+    bool saved_codegen_stats = options.codegen_stats;
 
-    func->sym_table = new_table();
-    tables->local = func->sym_table;
-    tables->function_name = function_name->ident;
+    // nothing of it reaches the output, nor the reports
+    options.codegen_stats = false;
+    stack_alignment = 0;
+    compile_function(func, scratch, tables);
 
-    Type funct = get_type(tables, function_name->ident);
+    options.codegen_stats = saved_codegen_stats;
+    stats = saved_stats;
+    inline_budget = saved_budget;
+    labels_count = saved_labels;
+    tables->call_graph->nodes[current_function].calls_count = saved_calls;
 
-    // define params
-    fillSymbolTable(tables->local, parameters);
+    fclose(scratch);
+    free(buffer);
+}
 
-    Node* body = SECONDCHILD(func);
+void compile_functions(Node* functions, FILE* file, Tables* tables) {
+    CallGraph* graph = tables->call_graph;
+
+    // without optimizations every function is written as soon as it is compiled
+    time_report_start(PHASE_FUNCTIONS);
+    if (options.optimize == 0) {
+        current_function = 0;
+        for (Node *child = functions->firstChild; child != NULL; child = child->nextSibling, current_function++) {
+            stack_alignment = 0; // reset stack
+            time_report_function_start();
+            compile_function(child, file, tables);
+            time_report_function_stop(graph->nodes[current_function].name);
+        }
+        time_report_stop(PHASE_FUNCTIONS);
+        return;
+    }
 
-    // define locals
-    Node* declarations = FIRSTCHILD(body);
-    fillSymbolTable(tables->local, declarations);
+    // functions unreachable from main are checked but not emitted
+    char** buffers = (char**)calloc(graph->count > 0 ? graph->count : 1, sizeof(char*));
+    size_t* sizes = (size_t*)calloc(graph->count > 0 ? graph->count : 1, sizeof(size_t));
+    int* order = (int*)malloc(sizeof(int) * (graph->count > 0 ? graph->count : 1));
+    if (buffers == NULL || sizes == NULL || order == NULL) {
+        perror("compile_functions");
+        exit(3);
+    }
 
-    Node* instructions = SECONDCHILD(body);
+    for (current_function = 0; current_function < graph->count; current_function++) {
+        if (!graph->nodes[current_function].reachable) {
+            compile_dead_function(graph->nodes[current_function].function, tables);
+            stats.dead_functions++;
+            continue;
+        }
 
-    if (strcmp(function_name->ident, "main") == 0) {
-        fprintf(file, 
-            "\n_start:\n"
-            "\tcall main\n"
-            "\tpush rax\n\n"
-            "\tmov rax, 60\n"
-            // "\tmov rdi, 0\n"
-            "\tpop rdi\n"
-            "\tsyscall\n"
-        );
+        FILE* function_file = open_memstream(&buffers[current_function], &sizes[current_function]);
+        if (function_file == NULL) {
+            perror("open_memstream");
+            exit(3);
+        }
+
+        stack_alignment = 0; // reset stack
+        time_report_function_start();
+        compile_function(graph->nodes[current_function].function, function_file, tables);
+        fclose(function_file);
+        time_report_function_stop(graph->nodes[current_function].name);
+    }
+    time_report_stop(PHASE_FUNCTIONS);
+
+    // functions whose calls were all inlined disappear from the layout
+    time_report_start(PHASE_OUTPUT);
+    int main_index = call_graph_index(graph, tables->global, "main");
+    int count = call_graph_layout(graph, main_index, order);
+
+    for (int i = 0; i < count; i++) {
+        fwrite(buffers[order[i]], 1, sizes[order[i]], file);
+        set_function_emitted(graph->nodes[order[i]].name);
+    }
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->nodes[i].reachable && !call_graph_layout_contains(order, count, i)) {
+            stats.inlined_functions++;
+        }
+        free(buffers[i]);
     }
 
+    time_report_stop(PHASE_OUTPUT);
+
+    free(buffers);
+    free(sizes);
+    free(order);
+}
+
+// the reports of the profiles are written when main returns, the runtime keeps rbx
+static void compile_start(FILE* file) {
+    bool reports = options.instrument != NULL || options.profile_functions;
     fprintf(file, 
-        "\n%s:\n"
-        "\tpush rbp\n"
-        "\tmov rbp, rsp\n\n",
-        function_name->ident
+        "\n_start:\n"
+        "\tcall main\n"
+        "\tmov %s, eax\n",
+        reports ? "ebx" : "edi"
     );
 
-    if (tables->local->size != 0) {
-        fprintf(file, "\tsub rsp, %d\n\n", tables->local->size);
-        insert_stack(file, tables->local->size);
+    if (options.instrument != NULL) {
+        fprintf(file,
+            "\tmov rdi, _profile_counters\n"
+            "\tmov esi, %d\n"
+            "\tmov rdx, _profile_path\n"
+            "\tmov ecx, %u\n"
+            "\tcall _write_profile\n",
+            profile_counters,
+            profile_shape()
+        );
+    }
+    if (options.profile_functions) {
+        fprintf(file,
+            "\tmov rdi, _function_profile\n"
+            "\tmov esi, %d\n"
+            "\tmov rdx, _function_names\n"
+            "\t%s\n"
+            "\tcall _write_function_profile\n",
+            profiled_functions,
+            options.function_report != NULL ? "mov rcx, _function_report" : "xor ecx, ecx"
+        );
     }
 
-    int j = 0;
-    for (Node *child = parameters->firstChild; child != NULL; child = child->nextSibling) {
-        char* ident = FIRSTCHILD(child)->ident;
-        char buffer[25];
-        get_string_address(tables, ident, buffer);
-
-        switch (j) {
-        case 0:
-            fprintf(file, "\tmov dword [%s], edi\n", buffer);
-            break;
-        case 1:
-            fprintf(file, "\tmov dword [%s], esi\n", buffer);
-            break;
-        case 2:
-            fprintf(file, "\tmov dword [%s], edx\n", buffer);
-            break;
-        case 3:
-            fprintf(file, "\tmov dword [%s], ecx\n", buffer);
-            break;
-        case 4:
-            fprintf(file, "\tmov dword [%s], e8\n", buffer);
-            break;
-        case 5:
-            fprintf(file, "\tmov dword [%s], e9\n", buffer);
-            break;
-        default:
-            fprintf(stderr, "Warning line %d: Arguments count > 6 not already working\n", child->lineno);
-            break;
+    if (reports) {
+        fprintf(file, "\tmov edi, ebx\n");
+    }
+    fprintf(file, "\tjmp _exit_program\n");
+}
+
+// leaves the function, rax holds the returned value
+void compile_epilogue(FILE* file, Tables* tables) {
+    if (tables->leaf) {
+        int size = tables->frame_size + stack_alignment;
+        if (size != 0) {
+            fprintf(file, "\tadd rsp, %d\n", size);
+            stats.prologue_bytes_saved -= size < 128 ? 4 : 7;
+        }
+        compile_profile_exit(file, tables);
+        fprintf(file, "\tret\n");
+
+        // mov rsp, rbp and pop rbp
+        stats.prologue_bytes_saved += 4;
+        return;
+    }
+
+    fprintf(file, 
+        "\tmov rsp, rbp\n"
+        "\tpop rbp\n"
+    );
+    compile_profile_exit(file, tables);
+    fprintf(file, "\tret\n");
+}
+
+void compile_function(Node* func, FILE* output, Tables* tables) {
+    // define function
+    Node* header = FIRSTCHILD(func);
+    Node* function_name = SECONDCHILD(header);
+    Node* parameters = THIRDCHILD(header);
+
+    func->sym_table = new_table();
+    tables->local = func->sym_table;
+    tables->function_name = function_name->ident;
+
+    Type funct = get_type(tables, function_name->ident);
+
+    // define params
+    fillSymbolTable(tables->local, parameters);
+
+    // parameters past the sixth are read where the caller stored them,
+    // above the return address and the saved rbp
+    int j = 0;
+    for (Node *child = parameters->firstChild; child != NULL; child = child->nextSibling, j++) {
+        if (j >= 6) {
+            table_get_symbol(tables->local, FIRSTCHILD(child)->ident)->address = -(16 + (j - 6) * 8);
+        }
+    }
+
+    CallGraphNode* node = call_graph_get(tables->call_graph, tables->global, function_name->ident);
+    const int* incoming = parameter_registers_of(node);
+
+    // a leaf and a function with its own convention keep their parameters in registers
+    int locations[6];
+    bool in_registers = node->leaf || node->custom;
+    j = 0;
+    for (Node *child = parameters->firstChild; child != NULL && j < 6; child = child->nextSibling, j++) {
+        locations[j] = node->custom ? node->registers[j] : leaf_registers[j];
+        if (in_registers) {
+            table_get_symbol(tables->local, FIRSTCHILD(child)->ident)->reg = register_name(locations[j], false);
+        }
+    }
+    if (node->custom) {
+        stats.custom_conventions++;
+    }
+
+    // r10 and r11 hold intermediate results unless a parameter lives there
+    static const int candidates[2] = {REG_R10, REG_R11};
+    holding_count = 0;
+    for (int i = 0; i < 2; i++) {
+        bool used = false;
+        for (int k = 0; k < j && in_registers; k++) {
+            if (locations[k] == candidates[i]) used = true;
         }
+        if (!used) holding_registers[holding_count++] = candidates[i];
+    }
+
+    Node* body = SECONDCHILD(func);
+
+    // define locals
+    Node* declarations = FIRSTCHILD(body);
+    fillSymbolTable(tables->local, declarations);
+    if (options.optimize > 0) {
+        share_stack_slots(func, tables->global, tables->local);
+    }
+
+    Node* instructions = SECONDCHILD(body);
+
+    char label_body[25];
+    get_new_label(label_body);
+    tables->body_label = label_body;
+    tables->accumulator = 0;
+
+    if (options.optimize > 0 && funct.function.return_type != TYPE_VOID) {
+        tables->accumulator = find_accumulator(instructions, function_name->ident);
+    }
+    if (tables->accumulator) {
+        // hidden local, the dot keeps it apart from TPC identifiers
+        Type acc_type;
+        acc_type.type = TYPE_PRIMITIF;
+        acc_type.primitif = TYPE_INT;
+
+        Symbol* symbol = new_symbol(acc_type, ACCUMULATOR);
+        symbol->address = next_address(tables->local, get_type_size(acc_type));
+        insert_symbol(tables->local, symbol);
+        stats.accumulator_functions++;
+    }
+
+    int self_tail_calls = stats.self_tail_calls;
+    int first_label = labels_count;
+
+    // the whole function goes through the peephole optimizer before reaching the output
+    char* function_buffer = NULL;
+    size_t function_size = 0;
+    FILE* file = open_memstream(&function_buffer, &function_size);
+    if (file == NULL) {
+        perror("open_memstream");
+        exit(3);
+    }
 
-        j++;
+    if (strcmp(function_name->ident, "main") == 0) {
+        compile_start(file);
+    }
+
+    // a leaf keeps no frame pointer, its locals are addressed from rsp
+    tables->leaf = node->leaf;
+    tables->frame_size = 0;
+    if (tables->leaf) {
+        stats.leaf_functions++;
+        tables->frame_size = (tables->local->size + 7) / 8 * 8;
+    }
+
+    // the body is compiled first, inlined calls can still grow the frame
+    char* body_buffer = NULL;
+    size_t body_size = 0;
+    FILE* body_file = open_memstream(&body_buffer, &body_size);
+    if (body_file == NULL) {
+        perror("open_memstream");
+        exit(3);
     }
 
-    bool have_returned = compile_instructions(instructions, file, tables);
+    max_stack_depth = 0;
+    bool have_returned = compile_instructions(instructions, body_file, tables);
     if (!have_returned && funct.function.return_type != TYPE_VOID) {
         fprintf(stderr, "Warning Line %d: The function %s must return a value\n", func->lineno, function_name->ident);
     }
+    if (!have_returned) {
+        compile_epilogue(body_file, tables);
+    }
+    fclose(body_file);
+
+    stack_alignment = 0;
+    fprintf(file, "\n%s:\n", function_name->ident);
+    compile_profile_enter(file, tables, parameters, incoming);
+
+    if (tables->leaf) {
+        if (tables->frame_size != 0) {
+            fprintf(file, "\tsub rsp, %d\n\n", tables->frame_size);
+        }
+
+        // push rbp and mov rbp, rsp
+        stats.prologue_bytes_saved += 4;
+    }
+    else {
+        fprintf(file, 
+            "\tpush rbp\n"
+            "\tmov rbp, rsp\n\n"
+        );
+
+        // locals, expression stack and outgoing arguments, rsp stays aligned on 16 bytes
+        int frame_size = (tables->local->size + max_stack_depth + tables->outgoing_size + 15) / 16 * 16;
+        if (frame_size != 0) {
+            fprintf(file, "\tsub rsp, %d\n\n", frame_size);
+        }
+    }
+
+    j = 0;
+    for (Node *child = parameters->firstChild; child != NULL && j < 6; child = child->nextSibling, j++) {
+        char* source = register_name(incoming[j], false);
+        if (!in_registers) {
+            store_variable(file, tables, FIRSTCHILD(child)->ident, source);
+            continue;
+        }
+
+        // the spill to the frame is saved, a move may remain; a char is cut to its byte
+        stats.prologue_bytes_saved += incoming[j] >= REG_R8 ? 4 : 3;
+        if (get_primitif_from_string(child->ident) == TYPE_CHAR) {
+            fprintf(file, "\tmovsx %s, %s\n", register_name(locations[j], false), byte_register_name(incoming[j]));
+            stats.prologue_bytes_saved -= 4;
+        }
+        else if (locations[j] != incoming[j]) {
+            fprintf(file, "\tmov %s, %s\n", register_name(locations[j], false), source);
+            stats.prologue_bytes_saved -= 3;
+        }
+    }
+
+    if (tables->accumulator) {
+        char buffer[40];
+        get_variable_operand(tables, ACCUMULATOR, buffer);
+        fprintf(file, "\tmov %s, %d\n", buffer, tables->accumulator == '*' ? 1 : 0);
+    }
+
+    // self tail calls are counted as calls, not as entries
+    compile_counter(file, func, PROFILE_EXECUTIONS);
+
+    if (stats.self_tail_calls != self_tail_calls) {
+        fprintf(file, "\t%s:\n", label_body);
+    }
+
+    fwrite(body_buffer, 1, body_size, file);
+    free(body_buffer);
+    fclose(file);
+
+    InstructionList* list = parse_instructions(function_buffer, function_size);
+    if (options.optimize > 0) {
+        peephole_optimize(list);
+    }
+    if (options.codegen_stats) {
+        FunctionStats function_stats = {0};
+        strncpy(function_stats.name, function_name->ident, sizeof(function_stats.name) - 1);
+        count_instruction_classes(list, &function_stats);
+        function_stats.max_stack_depth = max_stack_depth;
+        function_stats.frame_size = tables->local->size;
+        function_stats.labels = labels_count - first_label;
+        function_stats.emitted = options.optimize == 0;
+        add_function_stats(&function_stats);
+    }
+    write_instructions(list, output);
+
+    free_instructions(list);
+    free(function_buffer);
 }
 
 bool compile_instructions(Node* instructions, FILE* file, Tables* tables) {
@@ -326,7 +1173,7 @@ bool compile_instructions(Node* instructions, FILE* file, Tables* tables) {
     for (Node *child = instructions->firstChild; child != NULL; child = child->nextSibling) {
         bool returned = compile_instruction(child, file, tables);
         if (returned && !have_returned) {
-            if (child->nextSibling != NULL) {
+            if (child->nextSibling != NULL && tables->return_label == NULL) {
                 fprintf(stderr, "Line %d: unreachable instructions\n", child->lineno);
             }
             have_returned = true;
@@ -358,8 +1205,7 @@ bool compile_instruction(Node* instr, FILE* file, Tables* tables) {
 
     case function_call:
         compile_expression(instr, file, tables);
-        fprintf(file, "\tpop rax\n");
-        pop_stack(file);
+        pop_value(file, tables, "rax");
         break;
 
     case return_:
@@ -380,9 +1226,107 @@ bool compile_instruction(Node* instr, FILE* file, Tables* tables) {
     return have_returned;
 }
 
+// variables that share their slot or register copy nothing
+static bool is_copy_in_place(Node* instr, Tables* tables) {
+    Node* var = FIRSTCHILD(instr);
+    Node* expr = SECONDCHILD(instr);
+    if (expr->label != ident) return false;
+
+    Type target = get_type(tables, var->ident);
+    Type source = get_type(tables, expr->ident);
+    if (target.type != TYPE_PRIMITIF || source.type != TYPE_PRIMITIF || target.primitif != source.primitif) return false;
+
+    char target_operand[40];
+    char source_operand[40];
+    get_variable_operand(tables, var->ident, target_operand);
+    get_variable_operand(tables, expr->ident, source_operand);
+    return strcmp(target_operand, source_operand) == 0;
+}
+
+// x = constant is a single store
+static bool compile_constant_store(Node* instr, FILE* file, Tables* tables) {
+    Node* var = FIRSTCHILD(instr);
+    Node* expr = SECONDCHILD(instr);
+    int value;
+    if (!get_constant_value(expr, &value)) return false;
+
+    Type type = get_type(tables, var->ident);
+    if (type.type != TYPE_PRIMITIF) return false;
+
+    if (type.primitif == TYPE_CHAR && expr->label != character && tables->return_label == NULL) {
+        fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", var->lineno);
+    }
+
+    // a char keeps the value of its byte
+    if (type.primitif == TYPE_CHAR) {
+        value = (signed char)value;
+    }
+
+    char target[40];
+    get_variable_operand(tables, var->ident, target);
+    fprintf(file, "\tmov %s, %d\n", target, value);
+    return true;
+}
+
+// x = x + e and x = x - e without calls update the variable where it lives
+static bool compile_update(Node* instr, FILE* file, Tables* tables) {
+    Node* var = FIRSTCHILD(instr);
+    Node* expr = SECONDCHILD(instr);
+    if (expr->label != addsub || SECONDCHILD(expr) == NULL || !is_register_expression(expr, tables)) return false;
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+    Node* operand;
+    if (a->label == ident && strcmp(a->ident, var->ident) == 0) {
+        operand = b;
+    }
+    else if (expr->byte == '+' && b->label == ident && strcmp(b->ident, var->ident) == 0) {
+        operand = a;
+    }
+    else {
+        return false;
+    }
+
+    // a char would overflow its byte, the assignment stores it cut
+    Type type = get_type(tables, var->ident);
+    if (type.primitif == TYPE_CHAR) return false;
+
+    char* op = expr->byte == '+' ? "add" : "sub";
+    char source[40];
+    char target[40];
+    int value;
+
+    if (get_constant_value(operand, &value)) {
+        get_variable_operand(tables, var->ident, target);
+        if (value == 1 || value == -1) {
+            fprintf(file, "\t%s %s\n", (value == 1) == (expr->byte == '+') ? "inc" : "dec", target);
+        }
+        else if (value != 0) {
+            fprintf(file, "\t%s %s, %d\n", op, target, value);
+        }
+        return true;
+    }
+
+    // a variable in a register is added as is, anything else goes through eax
+    if (operand->label == ident) {
+        get_variable_operand(tables, operand->ident, source);
+    }
+    if (operand->label != ident || register_from_name(source) == -1) {
+        compile_register_expression(operand, file, tables, 0);
+        strcpy(source, "eax");
+    }
+
+    // a leaf addresses the variable from rsp, its operand comes after the evaluation
+    get_variable_operand(tables, var->ident, target);
+    fprintf(file, "\t%s %s, %s\n", op, target, source);
+    return true;
+}
+
 void compile_assignment(Node* instr, FILE* file, Tables* tables) {
     Node* var = FIRSTCHILD(instr);
 
+    if (options.optimize > 0 && (is_copy_in_place(instr, tables) || compile_constant_store(instr, file, tables) || compile_update(instr, file, tables))) return;
+
     Type type1 = get_type(tables, var->ident);
     Type type2 = compile_expression(SECONDCHILD(instr), file, tables);
 
@@ -396,47 +1340,139 @@ void compile_assignment(Node* instr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    if (type1.primitif == TYPE_CHAR && type2.primitif == TYPE_INT) {
+    if (type1.primitif == TYPE_CHAR && type2.primitif == TYPE_INT && tables->return_label == NULL) {
         fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", var->lineno);
     }
 
-    char buffer[25];
-    get_string_address(tables, var->ident, buffer);
+    pop_value(file, tables, "rax");
 
-    fprintf(file, 
-        "\tpop rax\n"
-        "\tmov dword [%s], eax\n", buffer
-    );
-    pop_stack(file);
+    // a leaf addresses the variable from rsp, the pop comes first
+    store_variable(file, tables, var->ident, "eax");
+}
+
+// a condition known at compile time, its code can be left out
+static bool get_condition_value(Node* expr, Tables* tables, int* value) {
+    return options.optimize > 0 && is_register_expression(expr, tables) && get_constant_value(expr, value);
+}
+
+static bool compile_branch(Node* instr, FILE* file, Tables* tables) {
+    if (instr->label == body) {
+        return compile_instructions(instr, file, tables);
+    }
+    return compile_instruction(instr, file, tables);
+}
+
+// code that never runs is still checked, then thrown away with what compiling it recorded
+static bool compile_unreachable(Node* instr, Tables* tables) {
+    char* buffer = NULL;
+    size_t size = 0;
+    FILE* scratch = open_memstream(&buffer, &size);
+    if (scratch == NULL) {
+        perror("open_memstream");
+        exit(3);
+    }
+
+    Stats saved_stats = stats;
+    int saved_budget = inline_budget;
+    int saved_alignment = stack_alignment;
+    int saved_calls = tables->call_graph->nodes[current_function].calls_count;
+
+    bool have_returned = compile_branch(instr, scratch, tables);
+
+    stats = saved_stats;
+    inline_budget = saved_budget;
+    stack_alignment = saved_alignment;
+    tables->call_graph->nodes[current_function].calls_count = saved_calls;
+
+    fclose(scratch);
+    free(buffer);
+    return have_returned;
+}
+
+// the branches are checked as usual, returning in both is what counts for the function
+static bool compile_constant_if(Node* instr, FILE* file, Tables* tables, bool taken) {
+    Node* then_instr = SECONDCHILD(instr);
+    Node* else_instr = THIRDCHILD(instr) != NULL ? FIRSTCHILD(THIRDCHILD(instr)) : NULL;
+
+    if (taken) {
+        compile_counter(file, instr, PROFILE_TAKEN);
+    }
+    bool have_returned_if = taken ? compile_branch(then_instr, file, tables) : compile_unreachable(then_instr, tables);
+    bool have_returned_else = false;
+    if (else_instr != NULL) {
+        have_returned_else = taken ? compile_unreachable(else_instr, tables) : compile_branch(else_instr, file, tables);
+    }
+
+    stats.constant_branches++;
+    return have_returned_if && have_returned_else;
+}
+
+// the else branch ran more often in the profile, it follows the condition without a jump
+static bool compile_inverted_if(Node* instr, FILE* file, Tables* tables) {
+    char label_then[25];
+    char label_after_else[25];
+    get_new_label(label_then);
+    get_new_label(label_after_else);
+
+    compile_condition(FIRSTCHILD(instr), file, tables, label_then, true);
+    bool have_returned_else = compile_branch(FIRSTCHILD(THIRDCHILD(instr)), file, tables);
+    fprintf(file, "\tjmp %s\n\n", label_after_else);
+
+    fprintf(file, "\t%s:\n", label_then);
+    compile_counter(file, instr, PROFILE_TAKEN);
+    bool have_returned_if = compile_branch(SECONDCHILD(instr), file, tables);
+    fprintf(file, "\t%s:\n", label_after_else);
+
+    stats.inverted_branches++;
+    return have_returned_if && have_returned_else;
 }
 
 bool compile_if(Node* instr, FILE* file, Tables* tables) {
     bool have_returned_if = false;
     bool have_returned_else = false; 
 
+    compile_counter(file, instr, PROFILE_EXECUTIONS);
+
+    int value;
+    Node* then_instr = SECONDCHILD(instr);
+    if (then_instr != NULL && then_instr->label != else_ && get_condition_value(FIRSTCHILD(instr), tables, &value)) {
+        return compile_constant_if(instr, file, tables, value != 0);
+    }
+
+    long long taken = profile_count(instr, PROFILE_TAKEN);
+    if (options.optimize > 0 && then_instr != NULL && then_instr->label != else_ && THIRDCHILD(instr) != NULL
+            && profile_count(instr, PROFILE_EXECUTIONS) - taken > taken) {
+        return compile_inverted_if(instr, file, tables);
+    }
+
     char label_after_if[25];
     get_new_label(label_after_if);
 
-    Type type = compile_expression(FIRSTCHILD(instr), file, tables);
-    if (type.type != TYPE_PRIMITIF) {
-        fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
-        exit(2);
-    }
-    if (type.primitif == TYPE_VOID) {
-        fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
-        exit(2);
+    if (options.optimize > 0) {
+        compile_condition(FIRSTCHILD(instr), file, tables, label_after_if, false);
     }
+    else {
+        Type type = compile_expression(FIRSTCHILD(instr), file, tables);
+        if (type.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
+            exit(2);
+        }
+        if (type.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
+            exit(2);
+        }
 
-    fprintf(file,
-        "\tpop rax\n"
-        "\tcmp rax, 0\n"
-        "\tje %s\n\n",
-        label_after_if
-    );
-    pop_stack(file);
+        pop_value(file, tables, "rax");
+        fprintf(file,
+            "\tcmp eax, 0\n"
+            "\tje %s\n\n",
+            label_after_if
+        );
+    }
 
     Node* if_body = SECONDCHILD(instr);
     if (if_body != NULL) {
+        compile_counter(file, instr, PROFILE_TAKEN);
         if (if_body->label == body) {
             have_returned_if = compile_instructions(if_body, file, tables);
         }
@@ -472,9 +1508,50 @@ bool compile_if(Node* instr, FILE* file, Tables* tables) {
     return have_returned_if && have_returned_else;
 }
 
+// the loop iterated more than once per entry in the profile, its condition is tested
+// at the bottom: one jump per iteration instead of two
+static bool compile_rotated_while(Node* instr, FILE* file, Tables* tables) {
+    char label_body[25];
+    char label_condition[25];
+    get_new_label(label_body);
+    get_new_label(label_condition);
+
+    fprintf(file, "\tjmp %s\n", label_condition);
+    fprintf(file, "\t%s:\n", label_body);
+
+    loop_depth++;
+    compile_counter(file, instr, PROFILE_ITERATIONS);
+    bool have_returned = compile_instructions(SECONDCHILD(instr), file, tables);
+    loop_depth--;
+
+    fprintf(file, "\t%s:\n", label_condition);
+    compile_condition(FIRSTCHILD(instr), file, tables, label_body, true);
+
+    stats.rotated_loops++;
+    return have_returned;
+}
+
 bool compile_while(Node* instr, FILE* file, Tables* tables) {
     bool have_returned = false;
 
+    compile_counter(file, instr, PROFILE_EXECUTIONS);
+
+    int value;
+    if (get_condition_value(FIRSTCHILD(instr), tables, &value) && value == 0) {
+        if (SECONDCHILD(instr) != NULL) {
+            loop_depth++;
+            compile_unreachable(SECONDCHILD(instr), tables);
+            loop_depth--;
+        }
+        stats.constant_branches++;
+        return false;
+    }
+
+    if (options.optimize > 0 && SECONDCHILD(instr) != NULL
+            && profile_count(instr, PROFILE_ITERATIONS) > profile_count(instr, PROFILE_EXECUTIONS)) {
+        return compile_rotated_while(instr, file, tables);
+    }
+
     char label_while[25];
     char label_after_while[25];
     get_new_label(label_while);
@@ -482,27 +1559,34 @@ bool compile_while(Node* instr, FILE* file, Tables* tables) {
 
     fprintf(file, "\t%s:\n", label_while);
 
-    Type type = compile_expression(FIRSTCHILD(instr), file, tables);
-    if (type.type != TYPE_PRIMITIF) {
-        fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
-        exit(2);
-    }
-    if (type.primitif == TYPE_VOID) {
-        fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
-        exit(2);
+    if (options.optimize > 0) {
+        compile_condition(FIRSTCHILD(instr), file, tables, label_after_while, false);
     }
+    else {
+        Type type = compile_expression(FIRSTCHILD(instr), file, tables);
+        if (type.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
+            exit(2);
+        }
+        if (type.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
+            exit(2);
+        }
 
-    fprintf(file,
-        "\tpop rax\n"
-        "\tcmp rax, 0\n"
-        "\tje %s\n\n",
-        label_after_while
-    );
-    pop_stack(file);
+        pop_value(file, tables, "rax");
+        fprintf(file,
+            "\tcmp eax, 0\n"
+            "\tje %s\n\n",
+            label_after_while
+        );
+    }
 
     Node* body = SECONDCHILD(instr);
     if (body != NULL) {
+        loop_depth++;
+        compile_counter(file, instr, PROFILE_ITERATIONS);
         have_returned = compile_instructions(body, file, tables);
+        loop_depth--;
    
         fprintf(file, "\tjmp %s\n", label_while);
     }
@@ -603,46 +1687,243 @@ int eval_constant_expression(Node* expr) {
         return expr->num;
 
     case character:;
-        return (int)expr->ident[1];
+        return get_character_value(expr->ident);
 
     default:
         return 0;
     }
 }
 
-bool compile_switch(Node* instr, FILE* file, Tables* tables) {
-    Type type = compile_expression(FIRSTCHILD(instr), file, tables);
-    if (type.type != TYPE_PRIMITIF) {
-        fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
-        exit(2);
-    }
-    if (type.primitif == TYPE_VOID) {
-        fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
-        exit(2);
-    }
+int get_character_value(char* character) {
+    if (character[1] != '\\') return (int)character[1];
 
-    Node* body = SECONDCHILD(instr);
+    switch (character[2]) {
+    case 'n':
+        return '\n';
+    case 't':
+        return '\t';
+    default:
+        return (int)character[2];
+    }
+}
 
-    char label_break[25];
-    get_new_label(label_break);
-    
-    int default_count = 0;
+// value of the operation on constant operands, b is unused by unary ones
+bool fold_operation(Node* expr, int a, int b, int* value) {
+    switch (expr->label) {
+    case addsub:
+        if (SECONDCHILD(expr) == NULL) {
+            *value = expr->byte == '-' ? (int)(0u - (unsigned int)a) : a;
+            return true;
+        }
+        // unsigned arithmetic wraps like the generated code does
+        *value = expr->byte == '-' ? (int)((unsigned int)a - (unsigned int)b) : (int)((unsigned int)a + (unsigned int)b);
+        return true;
 
-    int count = 0;
-    for (Node *node = body->firstChild; node != NULL; node = node->nextSibling) {
-        if (node->label == case_) {
-            count++;
+    case divstar:
+        if (expr->byte == '*') {
+            *value = (int)((unsigned int)a * (unsigned int)b);
+            return true;
         }
-    }
+        if (b == 0 || (b == -1 && a == -2147483647 - 1)) return false; // keep the runtime trap
+        *value = expr->byte == '/' ? a / b : a % b;
+        return true;
 
-    char* case_values = malloc(sizeof(int) * count);
-    if (case_values == NULL) {
-        perror("malloc");
+    case eq:
+        *value = strcmp(expr->comp, "==") == 0 ? a == b : a != b;
+        return true;
+
+    case order:
+        if (strcmp(expr->comp, "<") == 0) *value = a < b;
+        else if (strcmp(expr->comp, ">") == 0) *value = a > b;
+        else if (strcmp(expr->comp, "<=") == 0) *value = a <= b;
+        else *value = a >= b;
+        return true;
+
+    case not:
+        *value = !a;
+        return true;
+
+    // the generated code yields the second operand itself when it decides
+    case and:
+        *value = a ? b : 0;
+        return true;
+
+    case or:
+        *value = a ? 1 : b;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool get_constant_value(Node* expr, int* value) {
+    int a, b = 0;
+
+    switch (expr->label) {
+    case num:
+        *value = expr->num;
+        return true;
+
+    case character:
+        *value = get_character_value(expr->ident);
+        return true;
+
+    case addsub:
+    case divstar:
+    case eq:
+    case order:
+    case not:
+    case and:
+    case or:
+        if (!get_constant_value(FIRSTCHILD(expr), &a)) return false;
+        if (SECONDCHILD(expr) != NULL && !get_constant_value(SECONDCHILD(expr), &b)) return false;
+        return fold_operation(expr, a, b, value);
+
+    default:
+        return false;
+    }
+}
+
+// the last case or default has no following one to fall into
+static void check_last_entry(Node* node) {
+    Node* body = node->label == case_ ? SECONDCHILD(node) : FIRSTCHILD(node);
+    if (FIRSTCHILD(body) == NULL) {
+        fprintf(stderr, "Line %d: Last %s can't be empty\n", body->lineno, node->label == case_ ? "case" : "default");
+        exit(2);
+    }
+}
+
+static bool contains_break(Node* instructions) {
+    for (Node *child = instructions->firstChild; child != NULL; child = child->nextSibling) {
+        if (child->label == break_) return true;
+    }
+    return false;
+}
+
+// without fallthrough and with the default last, the cases can be tested in any order
+static bool is_dispatchable(Node* body) {
+    for (Node *node = body->firstChild; node != NULL; node = node->nextSibling) {
+        if (node->label != case_ && node->label != default_) return false;
+        if (node->nextSibling == NULL) return true;
+        if (node->label == default_ || !contains_break(SECONDCHILD(node))) return false;
+    }
+    return true;
+}
+
+// the value is compared to the cases from the most frequent one in the profile,
+// then the bodies follow in the order of the source
+static void compile_profiled_switch(Node* body, FILE* file, Tables* tables, char label_break[25], int* case_values, int* default_count) {
+    int count = 0;
+    for (Node *node = body->firstChild; node != NULL; node = node->nextSibling) {
+        count++;
+    }
+
+    Node** entries = (Node**)malloc(sizeof(Node*) * (count > 0 ? count : 1));
+    char (*labels)[25] = malloc(sizeof(char[25]) * (count > 0 ? count : 1));
+    int* values = (int*)malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (entries == NULL || labels == NULL || values == NULL) {
+        perror("malloc");
         exit(3);
     }
 
     int i = 0;
+    int cases = 0;
+    for (Node *node = body->firstChild; node != NULL; node = node->nextSibling, i++) {
+        entries[i] = node;
+        get_new_label(labels[i]);
+        if (node->label == case_) {
+            verify_constant_expression(FIRSTCHILD(node));
+            values[i] = eval_constant_expression(FIRSTCHILD(node));
+            case_values[cases++] = values[i];
+        }
+    }
+
+    // a selection sort keeps the order of the source between equal counts
+    bool* tested = (bool*)calloc(count > 0 ? count : 1, sizeof(bool));
+    if (tested == NULL) {
+        perror("calloc");
+        exit(3);
+    }
+    peek_value(file, tables, "rax");
+    for (int k = 0; k < cases; k++) {
+        int best = -1;
+        for (i = 0; i < count; i++) {
+            if (entries[i]->label != case_ || tested[i]) continue;
+            if (best == -1 || profile_count(entries[i], PROFILE_EXECUTIONS) > profile_count(entries[best], PROFILE_EXECUTIONS)) best = i;
+        }
+        tested[best] = true;
+        fprintf(file,
+            "\tcmp eax, %d\n"
+            "\tje %s\n",
+            values[best], labels[best]
+        );
+    }
+
+    bool has_default = count > 0 && entries[count - 1]->label == default_;
+    fprintf(file, "\tjmp %s\n\n", has_default ? labels[count - 1] : label_break);
+
+    for (i = 0; i < count; i++) {
+        fprintf(file, "\t%s:\n", labels[i]);
+        compile_counter(file, entries[i], PROFILE_EXECUTIONS);
+        if (entries[i]->label == case_) {
+            compile_switch_instructions(SECONDCHILD(entries[i]), file, tables, label_break);
+        }
+        else {
+            (*default_count)++;
+            compile_switch_instructions(FIRSTCHILD(entries[i]), file, tables, label_break);
+        }
+    }
+    if (count > 0) {
+        check_last_entry(entries[count - 1]);
+    }
+
+    stats.profiled_switches++;
+    free(tested);
+    free(values);
+    free(labels);
+    free(entries);
+}
+
+bool compile_switch(Node* instr, FILE* file, Tables* tables) {
+    Type type = compile_expression(FIRSTCHILD(instr), file, tables);
+    if (type.type != TYPE_PRIMITIF) {
+        fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
+        exit(2);
+    }
+    if (type.primitif == TYPE_VOID) {
+        fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
+        exit(2);
+    }
+
+    Node* body = SECONDCHILD(instr);
+
+    char label_break[25];
+    get_new_label(label_break);
+    
+    int default_count = 0;
+
+    int count = 0;
     for (Node *node = body->firstChild; node != NULL; node = node->nextSibling) {
+        if (node->label == case_) {
+            count++;
+        }
+    }
+
+    int* case_values = malloc(sizeof(int) * count);
+    if (case_values == NULL) {
+        perror("malloc");
+        exit(3);
+    }
+
+    int i = 0;
+    Node* node = body->firstChild;
+    if (options.optimize > 0 && profile_loaded() && is_dispatchable(body)) {
+        compile_profiled_switch(body, file, tables, label_break, case_values, &default_count);
+        node = NULL;
+    }
+
+    for (; node != NULL; node = node->nextSibling) {
         char label_next[25];
         get_new_label(label_next);
 
@@ -663,41 +1944,30 @@ bool compile_switch(Node* instr, FILE* file, Tables* tables) {
                 exit(2);
             }
 
+            pop_value(file, tables, "rcx");
+            peek_value(file, tables, "rax"); // laisse dans la pile pour le prochain case
             fprintf(file, 
-                "\tpop rcx\n"
-                "\tpop rax\n"
-                "\tpush rax\n"  // remet dans la pile pour le prochain case
-                "\tcmp rax, rcx\n"
+                "\tcmp eax, ecx\n"
                 "\tjne %s\n\n",
                 label_next
             );
-            pop_stack(file);
 
+            compile_counter(file, node, PROFILE_EXECUTIONS);
             compile_switch_instructions(SECONDCHILD(node), file, tables, label_break);
 
             if (node->nextSibling == NULL) {
-                Node* body = SECONDCHILD(node);
-                Node* child = FIRSTCHILD(body);
-
-                if (child == NULL) {
-                    fprintf(stderr, "Line %d: Last case can't be empty\n", body->lineno);
-                    exit(2);
-                }
+                check_last_entry(node);
             }
 
             break;
 
         case default_:;
             default_count++;
+            compile_counter(file, node, PROFILE_EXECUTIONS);
             compile_switch_instructions(FIRSTCHILD(node), file, tables, label_break);
 
             if (node->nextSibling == NULL) {
-                Node* body = FIRSTCHILD(node);
-                Node* child = FIRSTCHILD(body);
-                if (child == NULL) {
-                    fprintf(stderr, "Line %d: Last default can't be empty\n", body->lineno);
-                    exit(2);
-                }
+                check_last_entry(node);
             }
 
             break;
@@ -709,12 +1979,8 @@ bool compile_switch(Node* instr, FILE* file, Tables* tables) {
         fprintf(file, "\t%s:\n", label_next);
     }
 
-    fprintf(file, 
-        "\t%s:\n"
-        "\tpop rax\n", // enleve de la pile lexpression du switch
-        label_break
-    );
-    pop_stack(file);
+    fprintf(file, "\t%s:\n", label_break);
+    pop_value(file, tables, "rax"); // enleve de la pile lexpression du switch
 
     if (default_count > 1) {
         fprintf(stderr, "Line %d: switch must have max 1 default, %d counted\n", instr->lineno, default_count);
@@ -746,7 +2012,7 @@ bool compile_switch_instructions(Node* instr, FILE* file, Tables* tables, char l
 
         bool returned = compile_instruction(child, file, tables);
         if (returned && !have_returned) {
-            if (child->nextSibling != NULL) {
+            if (child->nextSibling != NULL && tables->return_label == NULL) {
                 fprintf(stderr, "Line %d: unreachable instructions\n", child->lineno);
             }
             have_returned = true;
@@ -756,46 +2022,256 @@ bool compile_switch_instructions(Node* instr, FILE* file, Tables* tables, char l
     return have_returned;
 }
 
-bool compile_return(Node* instr, FILE* file, Tables* tables) {
+static bool is_call_to(Node* expr, char* name) {
+    return expr->label == function_call && strcmp(FIRSTCHILD(expr)->ident, name) == 0;
+}
+
+// x op f(...) with x free of calls, x is folded into the accumulator before the call
+// like it is evaluated before it; in f(...) op x the call could change a global x reads
+static Node* get_accumulator_call(Node* expr, char* name, char op, Node** operand) {
+    if (op == '+' && (expr->label != addsub || expr->byte != '+' || SECONDCHILD(expr) == NULL)) return NULL;
+    if (op == '*' && (expr->label != divstar || expr->byte != '*')) return NULL;
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+
+    if (is_call_to(b, name) && !call_graph_contains_call(a)) {
+        *operand = a;
+        return b;
+    }
+    return NULL;
+}
+
+static bool collect_accumulator(Node* node, char* name, char* op) {
+    if (node->label == return_ && FIRSTCHILD(node) != NULL) {
+        Node* operand;
+        char candidates[] = {'+', '*'};
+
+        for (int i = 0; i < 2; i++) {
+            if (get_accumulator_call(FIRSTCHILD(node), name, candidates[i], &operand) == NULL) continue;
+            if (*op != 0 && *op != candidates[i]) return false;
+            *op = candidates[i];
+        }
+    }
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        if (!collect_accumulator(child, name, op)) return false;
+    }
+    return true;
+}
+
+char find_accumulator(Node* instructions, char* name) {
+    char op = 0;
+    if (!collect_accumulator(instructions, name, &op)) return 0;
+    return op;
+}
+
+static bool is_self_tail_call(Node* instr, char* name, char accumulator) {
+    Node* expr = FIRSTCHILD(instr);
+    Node* operand;
+
+    if (!is_call_to(expr, name)) {
+        if (accumulator == 0) return false;
+        expr = get_accumulator_call(expr, name, accumulator, &operand);
+        if (expr == NULL) return false;
+    }
+
+    Node* params = SECONDCHILD(expr);
+    return params == NULL || !call_graph_contains_call(params);
+}
+
+// no call survives in the generated code, self tail calls become jumps
+bool is_leaf(Node* node, char* name, char accumulator) {
+    if (node->label == return_ && FIRSTCHILD(node) != NULL && is_self_tail_call(node, name, accumulator)) {
+        return true;
+    }
+    if (node->label == function_call) return false;
+
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+        if (!is_leaf(child, name, accumulator)) return false;
+    }
+    return true;
+}
+
+static void check_return_type(Node* instr, Tables* tables, Type type) {
     Type function_type = get_type(tables, tables->function_name);
 
-    Node* child = FIRSTCHILD(instr);
-    if (child != NULL) {
-        Type type = compile_expression(child, file, tables);
-        
-        if (type.type != TYPE_PRIMITIF) {
-            fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
+    if (type.type != TYPE_PRIMITIF) {
+        fprintf(stderr, "Line %d: A primitif type is required here\n", instr->lineno);
+        exit(2);
+    } 
+    if (type.primitif == TYPE_VOID) {
+        fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
+        exit(2);
+    }
+    if (function_type.function.return_type == TYPE_VOID && tables->return_label == NULL) {
+        fprintf(stderr, "Warning Line %d: Function %s must return void and something returned\n", instr->lineno, tables->function_name);
+    }
+    if (type.primitif == TYPE_INT && function_type.function.return_type == TYPE_CHAR && tables->return_label == NULL) {
+        fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", instr->lineno);
+    }
+}
+
+// return f(...) leaves the frame and jumps to f, a call to the function itself
+// reuses the frame and jumps back to the body
+static bool compile_tail_return(Node* instr, FILE* file, Tables* tables) {
+    Node* expr = FIRSTCHILD(instr);
+    Node* operand = NULL;
+    Node* call = expr;
+
+    if (tables->accumulator) {
+        Node* acc_call = get_accumulator_call(expr, tables->function_name, tables->accumulator, &operand);
+        if (acc_call != NULL) call = acc_call;
+    }
+
+    if (call->label != function_call) return false;
+
+    char* name = FIRSTCHILD(call)->ident;
+    bool self = strcmp(name, tables->function_name) == 0;
+
+    if (!self) {
+        // the result still has to be combined with the accumulator
+        if (tables->accumulator) return false;
+
+        // errors are reported by the usual path
+        if (table_contains(tables->local, name) || !table_contains(tables->global, name)) return false;
+
+        Type t = table_get_type(tables->global, name);
+        if (t.type != TYPE_FUNCTION || t.function.args_count > 6) return false;
+
+        // the int result would have to be cut to a byte after the call
+        Type function_type = get_type(tables, tables->function_name);
+        if (function_type.function.return_type == TYPE_CHAR && t.function.return_type != TYPE_CHAR) return false;
+
+        CallGraphNode* callee = call_graph_get(tables->call_graph, tables->global, name);
+        if (should_inline(tables, callee, t.function.args_count, call)) return false;
+    }
+
+    Type type;
+    type.type = TYPE_PRIMITIF;
+    type.primitif = TYPE_INT;
+
+    if (operand != NULL) {
+        Type t = compile_expression(operand, file, tables);
+        if (t.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", expr->lineno);
             exit(2);
-        } 
-        if (type.primitif == TYPE_VOID) {
-            fprintf(stderr, "Line %d: this expression can't have void type\n", instr->lineno);
+        }
+        if (t.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", expr->lineno);
             exit(2);
         }
-        if (function_type.function.return_type == TYPE_VOID) {
-            fprintf(stderr, "Warning Line %d: Function %s must return void and something returned\n", instr->lineno, tables->function_name);
+
+        pop_value(file, tables, "rax");
+
+        char buffer[40];
+        get_variable_operand(tables, ACCUMULATOR, buffer);
+
+        if (tables->accumulator == '+') {
+            fprintf(file, "\tadd %s, eax\n", buffer);
         }
-        if (type.primitif == TYPE_INT && function_type.function.return_type == TYPE_CHAR) {
-            fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", instr->lineno);
+        else {
+            fprintf(file, 
+                "\timul eax, %s\n"
+                "\tmov %s, eax\n",
+                buffer, buffer
+            );
         }
+    }
 
-        fprintf(file, "\tpop rax\n\n");
-        pop_stack(file);
+    Type func_type = compile_call_arguments(call, file, tables, !self);
+    if (operand == NULL) {
+        type.primitif = func_type.function.return_type;
     }
-    else {
-        if (function_type.function.return_type != TYPE_VOID) {
-            fprintf(stderr, "Warning Line %d: Function %s must return something and nothing returned\n", instr->lineno, tables->function_name);
-        } 
+    check_return_type(instr, tables, type);
+    compile_counter(file, call, PROFILE_EXECUTIONS);
+
+    if (self) {
+        CallGraphNode* node = call_graph_get(tables->call_graph, tables->global, name);
+        Node* parameters = THIRDCHILD(FIRSTCHILD(node->function));
+        pop_arguments_to_slots(file, tables, parameters, func_type.function.args_count);
+
+        // only a leaf moved rsp, a switch may have left its value
+        if (tables->leaf && stack_alignment != 0) {
+            fprintf(file, "\tadd rsp, %d\n", stack_alignment);
+        }
+        fprintf(file, "\tjmp %s\n", tables->body_label);
+        stats.self_tail_calls++;
+        return true;
     }
 
+    // the callee is timed apart from the function it replaces
     fprintf(file, 
         "\tmov rsp, rbp\n"
         "\tpop rbp\n"
-        "\tret\n"
     );
+    compile_profile_tail_exit(file, tables);
+    fprintf(file, "\tjmp %s\n", name);
+    record_call(tables, name, call);
+    stats.tail_calls++;
+    return true;
+}
+
+bool compile_return(Node* instr, FILE* file, Tables* tables) {
+    Type function_type = get_type(tables, tables->function_name);
+
+    Node* child = FIRSTCHILD(instr);
+    if (child != NULL && tables->return_label == NULL && options.optimize > 0) {
+        if (compile_tail_return(instr, file, tables)) return true;
+    }
+
+    if (child != NULL) {
+        Type type = compile_expression(child, file, tables);
+        check_return_type(instr, tables, type);
+
+        pop_value(file, tables, "rax");
+
+        if (tables->accumulator) {
+            char buffer[40];
+            get_variable_operand(tables, ACCUMULATOR, buffer);
+            fprintf(file, "\t%s eax, %s\n", tables->accumulator == '+' ? "add" : "imul", buffer);
+        }
+
+        // a char function returns the low byte, like a char variable keeps it
+        if (function_type.function.return_type == TYPE_CHAR && (type.primitif != TYPE_CHAR || tables->accumulator)) {
+            fprintf(file, "\tmovsx eax, al\n");
+        }
+    }
+    else {
+        if (function_type.function.return_type != TYPE_VOID && tables->return_label == NULL) {
+            fprintf(stderr, "Warning Line %d: Function %s must return something and nothing returned\n", instr->lineno, tables->function_name);
+        } 
+    }
+
+    if (tables->return_label != NULL) {
+        // inlined body: rsp never moves in the caller, join it
+        fprintf(file, "\tjmp %s\n", tables->return_label);
+        return true;
+    }
+
+    compile_epilogue(file, tables);
     return true;
 }
 
 Type compile_expression(Node* expr, FILE* file, Tables* tables) {
+    // without calls the operands can be evaluated in any order and kept in registers
+    bool operation = expr->label != num && expr->label != character && expr->label != ident;
+    if (options.optimize > 0 && operation && is_register_expression(expr, tables)) {
+        Type type;
+        int value;
+        if (get_constant_value(expr, &value)) {
+            push_number(file, tables, value);
+            type.type = TYPE_PRIMITIF;
+            type.primitif = TYPE_INT;
+            return type;
+        }
+
+        type = compile_register_expression(expr, file, tables, 0);
+        push_value(file, tables, "rax");
+        stats.register_expressions++;
+        return type;
+    }
+
     switch (expr->label) {
     case not:
         return compile_not(expr, file, tables);
@@ -861,13 +2337,13 @@ Type compile_not(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
+    pop_value(file, tables, "rax");
     fprintf(file,
-        "\tpop rdi\n"
-        "\tmov eax, 0\n"
-        "\ttest edi, edi\n"
+        "\ttest eax, eax\n"
         "\tsete al\n"
-        "\tpush rax\n"
+        "\tmovzx eax, al\n"
     );
+    push_value(file, tables, "rax");
     
     type.primitif = TYPE_INT;
     return type;
@@ -892,13 +2368,12 @@ Type compile_or(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
+    pop_value(file, tables, "rax");
     fprintf(file,
-        "\tpop rax\n"
-        "\tcmp rax, 0\n"
+        "\tcmp eax, 0\n"
         "\tjne %s\n",
         label_true
     );
-    pop_stack(file);
 
     Type type2 = compile_expression(SECONDCHILD(expr), file, tables);
     if (type2.type != TYPE_PRIMITIF) {
@@ -912,14 +2387,15 @@ Type compile_or(Node* expr, FILE* file, Tables* tables) {
 
     fprintf(file,
         "\tjmp %s\n"
-        "\t%s:\n"
-        "\tpush 1\n"
         "\t%s:\n",
         label_b,
-        label_true,
-        label_b
+        label_true
     );
-    // push already notified :(
+
+    // the second operand is not evaluated on this branch, its slot gets the result
+    pop_stack(file);
+    push_value(file, tables, "1");
+    fprintf(file, "\t%s:\n", label_b);
     
     type.primitif = TYPE_INT;
     return type;
@@ -944,13 +2420,12 @@ Type compile_and(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
+    pop_value(file, tables, "rax");
     fprintf(file,
-        "\tpop rax\n"
-        "\tcmp rax, 0\n"
+        "\tcmp eax, 0\n"
         "\tje %s\n",
         label_false
     );
-    pop_stack(file);
 
     Type type2 = compile_expression(SECONDCHILD(expr), file, tables);
     if (type2.type != TYPE_PRIMITIF) {
@@ -964,14 +2439,15 @@ Type compile_and(Node* expr, FILE* file, Tables* tables) {
 
     fprintf(file,
         "\tjmp %s\n"
-        "\t%s:\n"
-        "\tpush 0\n"
         "\t%s:\n",
         label_b,
-        label_false,
-        label_b
+        label_false
     );
-    // push already notified :(
+
+    // the second operand is not evaluated on this branch, its slot gets the result
+    pop_stack(file);
+    push_value(file, tables, "0");
+    fprintf(file, "\t%s:\n", label_b);
 
     type.primitif = TYPE_INT;
     return type;
@@ -998,13 +2474,9 @@ Type compile_eq(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpop rcx\n"
-        "\tpop rax\n"
-        "\tcmp rax, rcx\n"
-    );
-    pop_stack(file);
-    pop_stack(file);
+    pop_value(file, tables, "rcx");
+    pop_value(file, tables, "rax");
+    fprintf(file, "\tcmp eax, ecx\n");
 
     if (strcmp(expr->comp, "==") == 0) {
         fprintf(file, "\tje %s\n", label_true);
@@ -1018,17 +2490,7 @@ Type compile_eq(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpush 0\n"
-        "\tjmp %s\n"
-        "\t%s:\n"
-        "\tpush 1\n"
-        "\t%s:\n",
-        label_false,
-        label_true,
-        label_false
-    );
-    push_stack(file);
+    push_condition(file, tables, label_true, label_false);
     
     type.primitif = TYPE_INT;
     return type;
@@ -1055,13 +2517,9 @@ Type compile_order(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpop rcx\n"
-        "\tpop rax\n"
-        "\tcmp rax, rcx\n"
-    );
-    pop_stack(file);
-    pop_stack(file);
+    pop_value(file, tables, "rcx");
+    pop_value(file, tables, "rax");
+    fprintf(file, "\tcmp eax, ecx\n");
 
     if (strcmp(expr->comp, "<") == 0) {
         fprintf(file, "\tjl %s\n", label_true);
@@ -1080,17 +2538,7 @@ Type compile_order(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpush 0\n"
-        "\tjmp %s\n"
-        "\t%s:\n"
-        "\tpush 1\n"
-        "\t%s:\n",
-        label_false,
-        label_true,
-        label_false
-    );
-    push_stack(file);
+    push_condition(file, tables, label_true, label_false);
     
     type.primitif = TYPE_INT;
     return type;
@@ -1110,13 +2558,13 @@ Type compile_unary_addsub(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file, "\tpop rax\n");
+    pop_value(file, tables, "rax");
 
     if (expr->byte == '-') {
         fprintf(file, "\tneg rax\n"); // valide ?
     }
 
-    fprintf(file, "\tpush rax\n");
+    push_value(file, tables, "rax");
 
 
     type.primitif = TYPE_INT;
@@ -1142,12 +2590,8 @@ Type compile_addsub(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpop rcx\n"
-        "\tpop rax\n"
-    );
-    pop_stack(file);
-    pop_stack(file);
+    pop_value(file, tables, "rcx");
+    pop_value(file, tables, "rax");
 
     switch (expr->byte) {
     case '+':
@@ -1160,20 +2604,213 @@ Type compile_addsub(Node* expr, FILE* file, Tables* tables) {
         break;
     }
 
-    fprintf(file, "\tpush rax\n");
-    push_stack(file);
+    push_value(file, tables, "rax");
 
     type.primitif = TYPE_INT;
     return type;
 }
 
-Type compile_divstar(Node* expr, FILE* file, Tables* tables) {
-    Type type;
-    type.type = TYPE_PRIMITIF;
+static bool is_power_of_two(unsigned int n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+static int log2_of(unsigned int n) {
+    int k = 0;
+    while (n >>= 1) k++;
+    return k;
+}
+
+// Hacker's Delight signed magic number: x / d == (mulhi(x, M) [+-x]) >> s, rounded toward zero
+static void get_division_magic(int d, int* multiplier, int* shift) {
+    const unsigned int two31 = 0x80000000u;
+    unsigned int ad = d < 0 ? 0u - (unsigned int)d : (unsigned int)d;
+    unsigned int t = two31 + ((unsigned int)d >> 31);
+    unsigned int anc = t - 1 - t % ad;
+    unsigned int q1 = two31 / anc, r1 = two31 - q1 * anc;
+    unsigned int q2 = two31 / ad, r2 = two31 - q2 * ad;
+    unsigned int delta;
+    int p = 31;
+
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *multiplier = (int)(q2 + 1);
+    if (d < 0) *multiplier = -*multiplier;
+    *shift = p - 32;
+}
+
+// eax = eax * value
+static void compile_multiplication_by_constant(FILE* file, int value) {
+    unsigned int n = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    if (n == 0) {
+        fprintf(file, "\txor eax, eax\n");
+        return;
+    }
+
+    int shift = 0;
+    while ((n & 1) == 0) {
+        n >>= 1;
+        shift++;
+    }
+
+    switch (n) {
+    case 1:
+        break;
+    case 3:
+    case 5:
+    case 9:
+        fprintf(file, "\tlea eax, [rax + rax * %u]\n", n - 1);
+        break;
+    default:
+        fprintf(file, "\timul eax, eax, %d\n", value);
+        return;
+    }
+
+    if (shift) {
+        fprintf(file, "\tshl eax, %d\n", shift);
+    }
+    if (value < 0) {
+        fprintf(file, "\tneg eax\n");
+    }
+}
+
+// eax = eax / value or eax % value, truncated toward zero like idiv
+static void compile_division_by_constant(FILE* file, int value, bool modulo) {
+    unsigned int n = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    if (n == 1) {
+        if (modulo) {
+            fprintf(file, "\txor eax, eax\n");
+        }
+        else if (value < 0) {
+            fprintf(file, "\tneg eax\n");
+        }
+        return;
+    }
+
+    if (is_power_of_two(n)) {
+        int k = log2_of(n);
+
+        // bias negative dividends by n - 1 so the shift rounds toward zero
+        fprintf(file,
+            "\tmov ecx, eax\n"
+            "\tsar ecx, 31\n"
+            "\tshr ecx, %d\n",
+            32 - k
+        );
+
+        if (modulo) {
+            fprintf(file,
+                "\tlea edx, [rax + rcx]\n"
+                "\tand edx, %d\n"
+                "\tsub eax, edx\n",
+                (int)(0u - n)
+            );
+            return;
+        }
+
+        fprintf(file,
+            "\tadd eax, ecx\n"
+            "\tsar eax, %d\n",
+            k
+        );
+        if (value < 0) {
+            fprintf(file, "\tneg eax\n");
+        }
+        return;
+    }
+
+    int multiplier, shift;
+    get_division_magic(value, &multiplier, &shift);
+
+    fprintf(file,
+        "\tmov ecx, eax\n"
+        "\tmov edx, %d\n"
+        "\timul edx\n",
+        multiplier
+    );
+
+    if (value > 0 && multiplier < 0) {
+        fprintf(file, "\tadd edx, ecx\n");
+    }
+    else if (value < 0 && multiplier > 0) {
+        fprintf(file, "\tsub edx, ecx\n");
+    }
+
+    if (shift) {
+        fprintf(file, "\tsar edx, %d\n", shift);
+    }
+
+    // add one when the quotient is negative
+    fprintf(file,
+        "\tmov eax, edx\n"
+        "\tshr eax, 31\n"
+        "\tadd eax, edx\n"
+    );
+
+    if (modulo) {
+        fprintf(file,
+            "\timul eax, eax, %d\n"
+            "\tsub ecx, eax\n"
+            "\tmov eax, ecx\n",
+            value
+        );
+    }
+}
+
+Type compile_divstar(Node* expr, FILE* file, Tables* tables) {
+    Type type;
+    type.type = TYPE_PRIMITIF;
 
     Node* a = FIRSTCHILD(expr);
     Node* b = SECONDCHILD(expr);
 
+    int value;
+    bool constant_right = options.optimize > 0 && get_constant_value(b, &value) && (expr->byte == '*' || value != 0);
+    bool constant_left = options.optimize > 0 && !constant_right && expr->byte == '*' && get_constant_value(a, &value);
+
+    if (constant_right || constant_left) {
+        // constants are never void nor functions, only the other operand needs checking
+        Type t = compile_expression(constant_right ? a : b, file, tables);
+        if (t.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", expr->lineno);
+            exit(2);
+        }
+        if (t.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", expr->lineno);
+            exit(2);
+        }
+
+        pop_value(file, tables, "rax");
+
+        if (expr->byte == '*') {
+            compile_multiplication_by_constant(file, value);
+        }
+        else {
+            compile_division_by_constant(file, value, expr->byte == '%');
+        }
+
+        push_value(file, tables, "rax");
+
+        type.primitif = TYPE_INT;
+        return type;
+    }
+
     Type type1 = compile_expression(a, file, tables);
     Type type2 = compile_expression(b, file, tables);
 
@@ -1186,36 +2823,31 @@ Type compile_divstar(Node* expr, FILE* file, Tables* tables) {
         exit(2);
     }
 
-    fprintf(file,
-        "\tpop rcx\n"
-        "\tpop rax\n"
-    );
-    pop_stack(file);
-    pop_stack(file);
+    pop_value(file, tables, "rcx");
+    pop_value(file, tables, "rax");
 
     switch (expr->byte) {
     case '*':
-        fprintf(file, "\timul rax, rcx\n");
+        fprintf(file, "\timul eax, ecx\n");
         break;
     case '/':
         fprintf(file, 
-            "\tmov rdx, 0\n" // divise rdx:rax par rcx
-            "\tidiv rcx\n"
+            "\tcdq\n" // divise edx:eax par ecx
+            "\tidiv ecx\n"
         );
         break;
     case '%':
         fprintf(file, 
-            "\tmov rdx, 0\n" // divise rdx:rax par rcx
-            "\tidiv rcx\n"
-            "\tmov rax, rdx\n"
+            "\tcdq\n" // divise edx:eax par ecx
+            "\tidiv ecx\n"
+            "\tmov eax, edx\n"
         );
         break;
     default:
         break;
     }
 
-    fprintf(file, "\tpush rax\n");
-    push_stack(file);
+    push_value(file, tables, "rax");
 
     type.primitif = TYPE_INT;
     return type;
@@ -1225,8 +2857,7 @@ Type compile_num(Node* expr, FILE* file, Tables* tables) {
     Type type;
     type.type = TYPE_PRIMITIF;
 
-    fprintf(file, "\tpush %d\n", expr->num);
-    push_stack(file);
+    push_number(file, tables, expr->num);
     
     type.primitif = TYPE_INT;
     return type;
@@ -1236,31 +2867,573 @@ Type compile_character(Node* expr, FILE* file, Tables* tables) {
     Type type;
     type.type = TYPE_PRIMITIF;
     
-    fprintf(file, "\tpush %s\n", expr->ident);
-    push_stack(file);
+    push_number(file, tables, get_character_value(expr->ident));
 
     type.primitif = TYPE_CHAR;
     return type;
 }
 
 Type compile_ident(Node* expr, FILE* file, Tables* tables) {
-    char buffer[25];
-    get_string_address(tables, expr->ident, buffer);
+    load_variable(file, tables, expr->ident, "eax");
+    push_value(file, tables, "rax");
 
-    fprintf(file, 
-        "\tmov eax, dword [%s]\n"
-        "\tpush rax\n", 
-        buffer
+    return get_type(tables, expr->ident);
+}
+
+// expressions without calls have no side effect, their operands can be evaluated in any order
+bool is_register_expression(Node* expr, Tables* tables) {
+    switch (expr->label) {
+    case num:
+    case character:
+        return true;
+
+    case ident: {
+        // functions and undeclared names are reported by the usual path
+        if (!table_contains(tables->local, expr->ident) && !table_contains(tables->global, expr->ident)) return false;
+        Type type = get_type(tables, expr->ident);
+        return type.type == TYPE_PRIMITIF && type.primitif != TYPE_VOID;
+    }
+
+    case not:
+    case or:
+    case and:
+    case eq:
+    case order:
+    case addsub:
+    case divstar:
+        for (Node *child = expr->firstChild; child != NULL; child = child->nextSibling) {
+            if (!is_register_expression(child, tables)) return false;
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// a constant or a variable, used as is by the instruction combining it; a char in memory
+// is a byte and has to be extended first
+static bool is_direct_operand(Node* expr, Tables* tables) {
+    int value;
+    if (get_constant_value(expr, &value)) return true;
+    if (expr->label != ident) return false;
+
+    char operand[40];
+    get_variable_operand(tables, expr->ident, operand);
+    return strncmp(operand, "byte", 4) != 0;
+}
+
+static void get_direct_operand(Node* expr, Tables* tables, char buffer[40]) {
+    int value;
+    if (get_constant_value(expr, &value)) {
+        sprintf(buffer, "%d", value);
+        return;
+    }
+    get_variable_operand(tables, expr->ident, buffer);
+}
+
+static bool is_commutative(Node* expr) {
+    switch (expr->label) {
+    case addsub:
+        return expr->byte == '+';
+    case divstar:
+        return expr->byte == '*';
+    case eq:
+    case order:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Sethi-Ullman number: registers needed besides eax to hold intermediate results
+static int get_register_need(Node* expr, Tables* tables) {
+    if (expr->label == ident || is_direct_operand(expr, tables)) return 0;
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+    if (b == NULL) return get_register_need(a, tables);
+
+    int need_a = get_register_need(a, tables);
+    int need_b = get_register_need(b, tables);
+
+    // the first operand is consumed before the second one is evaluated
+    if (expr->label == or || expr->label == and) return need_a > need_b ? need_a : need_b;
+
+    // a constant or a variable is combined with eax directly
+    if (is_direct_operand(b, tables)) return need_a;
+    if (is_direct_operand(a, tables)) return need_b;
+
+    if (need_a == need_b) return need_a + 1;
+    return need_a > need_b ? need_a : need_b;
+}
+
+static char* get_condition(char* comp, bool swapped) {
+    if (strcmp(comp, "==") == 0) return "e";
+    if (strcmp(comp, "!=") == 0) return "ne";
+    if (strcmp(comp, "<") == 0) return swapped ? "g" : "l";
+    if (strcmp(comp, ">") == 0) return swapped ? "l" : "g";
+    if (strcmp(comp, "<=") == 0) return swapped ? "ge" : "le";
+    return swapped ? "le" : "ge";
+}
+
+static char* get_inverse_condition(char* condition) {
+    static const char* conditions[][2] = {
+        {"e", "ne"}, {"ne", "e"}, {"l", "ge"}, {"ge", "l"}, {"g", "le"}, {"le", "g"},
+    };
+
+    for (int i = 0; i < 6; i++) {
+        if (strcmp(conditions[i][0], condition) == 0) return (char*)conditions[i][1];
+    }
+    return condition;
+}
+
+// eax = eax op operand, or operand op eax when swapped; the operand is never eax nor edx
+static void compile_register_operation(FILE* file, Node* expr, char* operand, bool swapped) {
+    switch (expr->label) {
+    case addsub:
+        fprintf(file, "\t%s eax, %s\n", expr->byte == '+' ? "add" : "sub", operand);
+        break;
+
+    case divstar:
+        if (expr->byte == '*') {
+            fprintf(file, "\timul eax, %s\n", operand);
+            break;
+        }
+        fprintf(file,
+            "\tcdq\n"
+            "\tidiv %s\n",
+            operand
+        );
+        if (expr->byte == '%') {
+            fprintf(file, "\tmov eax, edx\n");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// evaluates both operands of a binary operation, the first one into eax and the second
+// one into an operand for the instruction combining them, swapped when exchanged
+static void compile_register_operands(Node* expr, FILE* file, Tables* tables, int depth, char operand[40], bool* swapped) {
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+    *swapped = false;
+
+    if (is_direct_operand(b, tables)) {
+        compile_register_expression(a, file, tables, depth);
+        get_direct_operand(b, tables, operand);
+        return;
+    }
+
+    if (is_direct_operand(a, tables)) {
+        compile_register_expression(b, file, tables, depth);
+        if (is_commutative(expr)) {
+            get_direct_operand(a, tables, operand);
+            *swapped = true;
+            return;
+        }
+
+        char buffer[40];
+        get_direct_operand(a, tables, buffer);
+        fprintf(file,
+            "\tmov ecx, eax\n"
+            "\tmov eax, %s\n",
+            buffer
+        );
+        strcpy(operand, "ecx");
+        return;
+    }
+
+    // the operand needing more registers goes first, the other one fits in what is left
+    bool right_first = get_register_need(b, tables) > get_register_need(a, tables);
+    bool held = depth < holding_count;
+    char* holding = held ? register_name(holding_registers[depth], false) : NULL;
+
+    compile_register_expression(right_first ? b : a, file, tables, depth);
+    if (held) {
+        fprintf(file, "\tmov %s, eax\n", holding);
+    }
+    else {
+        push_value(file, tables, "rax");
+    }
+
+    compile_register_expression(right_first ? a : b, file, tables, depth + 1);
+
+    if (right_first || is_commutative(expr)) {
+        if (!held) {
+            pop_value(file, tables, "rcx");
+        }
+        strcpy(operand, held ? holding : "ecx");
+        *swapped = !right_first;
+        return;
+    }
+
+    fprintf(file, "\tmov ecx, eax\n");
+    if (held) {
+        fprintf(file, "\tmov eax, %s\n", holding);
+    }
+    else {
+        pop_value(file, tables, "rax");
+    }
+    strcpy(operand, "ecx");
+}
+
+// sets the flags for a comparison and returns the condition holding when it is true
+static char* compile_comparison(Node* expr, FILE* file, Tables* tables, int depth) {
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+    char operand[40];
+    bool swapped;
+    int value;
+
+    if (!is_register_expression(expr, tables)) {
+        Type type1 = compile_expression(a, file, tables);
+        Type type2 = compile_expression(b, file, tables);
+
+        if (type1.type != TYPE_PRIMITIF || type2.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", expr->lineno);
+            exit(2);
+        }
+        if (type1.primitif == TYPE_VOID || type2.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", expr->lineno);
+            exit(2);
+        }
+
+        pop_value(file, tables, "rcx");
+        pop_value(file, tables, "rax");
+        fprintf(file, "\tcmp eax, ecx\n");
+        return get_condition(expr->comp, false);
+    }
+
+    // a variable against a constant or a register is compared where it lives
+    if ((a->label == ident && is_direct_operand(a, tables) && is_direct_operand(b, tables)) || (b->label == ident && is_direct_operand(b, tables) && is_direct_operand(a, tables))) {
+        char other[40];
+        swapped = a->label != ident;
+        get_variable_operand(tables, swapped ? b->ident : a->ident, operand);
+        get_direct_operand(swapped ? a : b, tables, other);
+
+        bool in_memory = register_from_name(operand) == -1;
+        if (get_constant_value(swapped ? a : b, &value) || !in_memory || register_from_name(other) != -1) {
+            fprintf(file, "\tcmp %s, %s\n", operand, other);
+            return get_condition(expr->comp, swapped);
+        }
+    }
+
+    compile_register_operands(expr, file, tables, depth, operand, &swapped);
+    fprintf(file, "\tcmp eax, %s\n", operand);
+    return get_condition(expr->comp, swapped);
+}
+
+// jumps to label when the truth of the expression is jump_if, falls through otherwise,
+// so conditions need neither a value nor a test of it
+void compile_condition(Node* expr, FILE* file, Tables* tables, char label[25], bool jump_if) {
+    int value;
+    if (get_condition_value(expr, tables, &value)) {
+        if ((value != 0) == jump_if) {
+            fprintf(file, "\tjmp %s\n", label);
+        }
+        return;
+    }
+
+    switch (expr->label) {
+    case not:
+        compile_condition(FIRSTCHILD(expr), file, tables, label, !jump_if);
+        return;
+
+    case and:
+    case or: {
+        // the first operand decides alone when it is false for and, true for or
+        bool decisive = expr->label == or;
+        if (decisive == jump_if) {
+            compile_condition(FIRSTCHILD(expr), file, tables, label, jump_if);
+            compile_condition(SECONDCHILD(expr), file, tables, label, jump_if);
+            return;
+        }
+
+        char label_skip[25];
+        get_new_label(label_skip);
+        compile_condition(FIRSTCHILD(expr), file, tables, label_skip, decisive);
+        compile_condition(SECONDCHILD(expr), file, tables, label, jump_if);
+        fprintf(file, "\t%s:\n", label_skip);
+        return;
+    }
+
+    case eq:
+    case order: {
+        char* condition = compile_comparison(expr, file, tables, 0);
+        fprintf(file, "\tj%s %s\n", jump_if ? condition : get_inverse_condition(condition), label);
+        return;
+    }
+
+    default:
+        break;
+    }
+
+    Type type = compile_expression(expr, file, tables);
+    if (type.type != TYPE_PRIMITIF) {
+        fprintf(stderr, "Line %d: A primitif type is required here\n", expr->lineno);
+        exit(2);
+    }
+    if (type.primitif == TYPE_VOID) {
+        fprintf(stderr, "Line %d: this expression can't have void type\n", expr->lineno);
+        exit(2);
+    }
+
+    pop_value(file, tables, "rax");
+    fprintf(file,
+        "\ttest eax, eax\n"
+        "\tj%s %s\n",
+        jump_if ? "ne" : "e", label
     );
-    push_stack(file);
+}
 
-    return get_type(tables, expr->ident);
+static void compile_register_logical(Node* expr, FILE* file, Tables* tables, int depth) {
+    char label_true[25];
+    char label_end[25];
+    get_new_label(label_true);
+    get_new_label(label_end);
+
+    // like the stack path, the value of the second operand is the result when it is evaluated;
+    // and stops early with a zero already in eax
+    compile_register_expression(FIRSTCHILD(expr), file, tables, depth);
+    fprintf(file,
+        "\ttest eax, eax\n"
+        "\t%s %s\n",
+        expr->label == and ? "je" : "jne", expr->label == and ? label_end : label_true
+    );
+    compile_register_expression(SECONDCHILD(expr), file, tables, depth);
+    if (expr->label == or) {
+        fprintf(file,
+            "\tjmp %s\n"
+            "\t%s:\n"
+            "\tmov eax, 1\n",
+            label_end, label_true
+        );
+    }
+    fprintf(file, "\t%s:\n", label_end);
 }
 
-Type compile_function_call(Node* expr, FILE* file, Tables* tables) {
+// base + index * scale + displacement, the shape lea computes in one instruction
+typedef struct {
+    Node* terms[2];
+    int scales[2];
+    int count;
+    unsigned int displacement;
+} Address;
+
+static bool match_address(Node* expr, Address* address, bool negated) {
+    int value;
+    if (get_constant_value(expr, &value)) {
+        address->displacement += negated ? 0u - (unsigned int)value : (unsigned int)value;
+        return true;
+    }
+    if (negated || address->count == 2) return false;
+
+    if (expr->label == ident) {
+        address->terms[address->count] = expr;
+        address->scales[address->count++] = 1;
+        return true;
+    }
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+
+    if (expr->label == divstar && expr->byte == '*') {
+        Node* index = get_constant_value(b, &value) ? a : b;
+        if (index == b && !get_constant_value(a, &value)) return false;
+        if (index->label != ident || (value != 1 && value != 2 && value != 4 && value != 8)) return false;
+
+        address->terms[address->count] = index;
+        address->scales[address->count++] = value;
+        return true;
+    }
+
+    if (expr->label == addsub && b != NULL) {
+        if (!match_address(a, address, false)) return false;
+        if (expr->byte == '-') return get_constant_value(b, &value) && match_address(b, address, true);
+        return match_address(b, address, false);
+    }
+    return false;
+}
+
+// instructions of the generic path for an expression matched by match_address
+static int get_address_tree_cost(Node* expr) {
+    int value;
+    if (get_constant_value(expr, &value) || expr->label == ident) return 0;
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+    if (expr->label == divstar) {
+        return (get_constant_value(b, &value) || get_constant_value(a, &value)) && value == 1 ? 0 : 1;
+    }
+    return get_address_tree_cost(a) + get_address_tree_cost(b) + 1;
+}
+
+// lea when it takes fewer instructions than adding the terms one by one
+static bool compile_address(Node* expr, FILE* file, Tables* tables) {
+    Address address = {{NULL, NULL}, {1, 1}, 0, 0};
+    if (!match_address(expr, &address, false) || address.count == 0) return false;
+    if (address.count == 2 && address.scales[0] != 1 && address.scales[1] != 1) return false;
+
+    // the generic path loads the first term then combines the rest
+    int generic = 1 + get_address_tree_cost(expr);
+    int lea = 1;
+
+    char registers[2][8];
+    char* loaded[2] = {"rax", "rcx"};
+    for (int i = 0; i < address.count; i++) {
+        char operand[40];
+        get_variable_operand(tables, address.terms[i]->ident, operand);
+        int reg = register_from_name(operand);
+        strcpy(registers[i], reg != -1 ? register_name(reg, true) : loaded[i]);
+        if (reg == -1) lea++;
+    }
+    if (lea >= generic) return false;
+
+    for (int i = 0; i < address.count; i++) {
+        if (strcmp(registers[i], loaded[i]) == 0) {
+            load_variable(file, tables, address.terms[i]->ident, register_name(i == 0 ? REG_RAX : REG_RCX, false));
+        }
+    }
+
+    // the scaled term is the index, the displacement is printed signed
+    int index = address.count == 2 && address.scales[0] != 1 ? 0 : address.count - 1;
+    int displacement = (int)address.displacement;
+    fprintf(file, "\tlea eax, [");
+    if (address.count == 2) {
+        fprintf(file, "%s + ", registers[1 - index]);
+    }
+    fprintf(file, "%s", registers[index]);
+    if (address.scales[index] != 1) {
+        fprintf(file, " * %d", address.scales[index]);
+    }
+    if (displacement != 0) {
+        fprintf(file, " %c %u", displacement < 0 ? '-' : '+', displacement < 0 ? 0u - address.displacement : address.displacement);
+    }
+    fprintf(file, "]\n");
+    return true;
+}
+
+// evaluates into eax an expression accepted by is_register_expression, the operand
+// needing more registers first; results wait in the holding registers of depth and
+// above, and on the expression stack once they are all taken
+Type compile_register_expression(Node* expr, FILE* file, Tables* tables, int depth) {
     Type type;
     type.type = TYPE_PRIMITIF;
+    type.primitif = TYPE_INT;
+
+    char buffer[40];
+    int value;
+
+    if (expr->label == ident) {
+        load_variable(file, tables, expr->ident, "eax");
+        return get_type(tables, expr->ident);
+    }
+    if (is_direct_operand(expr, tables)) {
+        get_direct_operand(expr, tables, buffer);
+        fprintf(file, "\tmov eax, %s\n", buffer);
 
+        if (expr->label == character) type.primitif = TYPE_CHAR;
+        return type;
+    }
+
+    Node* a = FIRSTCHILD(expr);
+    Node* b = SECONDCHILD(expr);
+
+    if (expr->label == not || b == NULL) {
+        compile_register_expression(a, file, tables, depth);
+        if (expr->label == not) {
+            fprintf(file,
+                "\ttest eax, eax\n"
+                "\tsete al\n"
+                "\tmovzx eax, al\n"
+            );
+        }
+        else if (expr->byte == '-') {
+            fprintf(file, "\tneg eax\n");
+        }
+        return type;
+    }
+
+    if (expr->label == or || expr->label == and) {
+        compile_register_logical(expr, file, tables, depth);
+        return type;
+    }
+
+    if (expr->label == eq || expr->label == order) {
+        char* condition = compile_comparison(expr, file, tables, depth);
+        fprintf(file,
+            "\tset%s al\n"
+            "\tmovzx eax, al\n",
+            condition
+        );
+        return type;
+    }
+
+    if (expr->label == addsub && compile_address(expr, file, tables)) {
+        return type;
+    }
+
+    if (expr->label == divstar) {
+        bool constant_right = get_constant_value(b, &value) && (expr->byte == '*' || value != 0);
+        bool constant_left = !constant_right && expr->byte == '*' && get_constant_value(a, &value);
+
+        if (constant_right || constant_left) {
+            compile_register_expression(constant_right ? a : b, file, tables, depth);
+            if (expr->byte == '*') {
+                compile_multiplication_by_constant(file, value);
+            }
+            else {
+                compile_division_by_constant(file, value, expr->byte == '%');
+            }
+            return type;
+        }
+
+        // idiv takes no immediate, only a division by zero is left here
+        if (get_constant_value(b, &value)) {
+            compile_register_expression(a, file, tables, depth);
+            fprintf(file, "\tmov ecx, %d\n", value);
+            compile_register_operation(file, expr, "ecx", false);
+            return type;
+        }
+    }
+
+    bool swapped;
+    compile_register_operands(expr, file, tables, depth, buffer, &swapped);
+    compile_register_operation(file, expr, buffer, swapped);
+    return type;
+}
+
+// six registers, then the stack from rsp upwards
+static void pop_argument(FILE* file, Tables* tables, int j, const int* registers) {
+    if (j < 6) {
+        pop_value(file, tables, register_name(registers[j], true));
+        return;
+    }
+
+    pop_value(file, tables, "rax");
+    fprintf(file, "\tmov qword [rsp + %d], rax\n", (j - 6) * 8);
+}
+
+// the arguments still to evaluate must leave the place of an argument alone:
+// a call clobbers every argument register and the outgoing area, an expression
+// may use rcx, rdx, r10 and r11 while a variable or a constant uses only rax
+static bool can_pop_argument_early(Node* next, int reg) {
+    bool scratch = reg == REG_RCX || reg == REG_RDX || reg == REG_R10 || reg == REG_R11;
+    for (Node *child = next; child != NULL; child = child->nextSibling) {
+        if (call_graph_contains_call(child)) return false;
+        if (scratch && child->label != ident && child->label != num && child->label != character) return false;
+    }
+    return true;
+}
+
+// evaluates the arguments in order and checks them against the called function,
+// with to_registers they end in their registers and outgoing slots, otherwise
+// they are left on the expression stack, the last one on top
+Type compile_call_arguments(Node* expr, FILE* file, Tables* tables, bool to_registers) {
     Node* function_name = FIRSTCHILD(expr);
     Type func_type = get_type(tables, function_name->ident);
     if (func_type.type != TYPE_FUNCTION) {
@@ -1269,88 +3442,212 @@ Type compile_function_call(Node* expr, FILE* file, Tables* tables) {
     }
     
     Node* params = SECONDCHILD(expr);
-    if (params == NULL) {
-        if (func_type.function.args_count != 0) {
-            fprintf(stderr, "Line %d: Function %s requires %d parameters, 0 given\n", 
-                function_name->lineno, function_name->ident, func_type.function.args_count);
-            exit(2);
-        }
-    }
-    else {
-        int args_count = 0;
+    int args_count = 0;
+    if (params != NULL) {
         for (Node *child = params->firstChild; child != NULL; child = child->nextSibling) {
-            Type t = compile_expression(child, file, tables);
-            if (t.type != TYPE_PRIMITIF) {
-                fprintf(stderr, "Line %d: A primitif type is required here\n", child->lineno);
-                exit(2);
-            }
-            if (t.primitif == TYPE_VOID) {
-                fprintf(stderr, "Line %d: this expression can't have void type\n", child->lineno);
-                exit(2);
-            }
-            if (func_type.function.args_type[args_count] == TYPE_CHAR && t.primitif == TYPE_INT) {
-                fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", child->lineno);
-            }
-
             args_count++;
         }
+    }
+
+    if (args_count != func_type.function.args_count) {
+        fprintf(stderr, "Line %d: Function %s requires %d parameters, %d given\n", 
+            function_name->lineno, function_name->ident, func_type.function.args_count, args_count);
+        exit(2);
+    }
+    if (args_count == 0) {
+        return func_type;
+    }
+
+    // an internal function may take its arguments in other registers than System V ones
+    const int* registers = parameter_registers_of(call_graph_get(tables->call_graph, tables->global, function_name->ident));
 
-        if (args_count != func_type.function.args_count) {
-            fprintf(stderr, "Line %d: Function %s requires %d parameters, %d given\n", 
-                function_name->lineno, function_name->ident, func_type.function.args_count, args_count);
+    bool* stacked = (bool*)calloc(args_count, sizeof(bool));
+    if (stacked == NULL) {
+        perror("calloc");
+        exit(3);
+    }
+
+    int j = 0;
+    for (Node *child = params->firstChild; child != NULL; child = child->nextSibling, j++) {
+        Type t = compile_expression(child, file, tables);
+        if (t.type != TYPE_PRIMITIF) {
+            fprintf(stderr, "Line %d: A primitif type is required here\n", child->lineno);
             exit(2);
         }
-        
-        for (int j = func_type.function.args_count - 1; j > -1; j--) {
-            switch (j) {
-            case 0:
-                fprintf(file, "\tpop rdi\n");
-                pop_stack(file);
-                break;
-            case 1:
-                fprintf(file, "\tpop rsi\n");
-                pop_stack(file);
-                break;
-            case 2:
-                fprintf(file, "\tpop rdx\n");
-                pop_stack(file);
-                break;
-            case 3:
-                fprintf(file, "\tpop rcx\n");
-                pop_stack(file);
-                break;
-            case 4:
-                fprintf(file, "\tpop r8\n");
-                pop_stack(file);
-                break;
-            case 5:
-                fprintf(file, "\tpop r9\n");
-                pop_stack(file);
-                break;
-            default:
-                // already on the stack
-                break;
+        if (t.primitif == TYPE_VOID) {
+            fprintf(stderr, "Line %d: this expression can't have void type\n", child->lineno);
+            exit(2);
+        }
+        if (func_type.function.args_type[j] == TYPE_CHAR && t.primitif == TYPE_INT && tables->return_label == NULL) {
+            fprintf(stderr, "Warning line %d: Implicit convertion int -> char\n", child->lineno);
+        }
+
+        // straight into its place when nothing evaluated after can disturb it
+        if (to_registers && can_pop_argument_early(child->nextSibling, j < 6 ? registers[j] : -1)) {
+            pop_argument(file, tables, j, registers);
+        }
+        else {
+            stacked[j] = true;
+        }
+    }
+
+    if (to_registers) {
+        for (j = args_count - 1; j > -1; j--) {
+            if (stacked[j]) {
+                pop_argument(file, tables, j, registers);
             }
         }
     }
 
-    int required_alignment = get_required_alignment();
-    if (required_alignment) {
-        fprintf(file, "\tsub rsp, %d\n", required_alignment);
+    free(stacked);
+    return func_type;
+}
+
+// arguments were pushed in order, the last one is on top
+void pop_arguments_to_slots(FILE* file, Tables* tables, Node* parameters, int args_count) {
+    for (int j = args_count - 1; j > -1; j--) {
+        Node* child = parameters->firstChild;
+        for (int k = 0; k < j; k++) {
+            child = child->nextSibling;
+        }
+
+        pop_value(file, tables, "rax");
+
+        store_variable(file, tables, FIRSTCHILD(child)->ident, "eax");
+    }
+}
+
+// getchar and putchar read and write the runtime buffers in place,
+// the runtime is only called to refill or flush them
+static bool compile_builtin_fast_path(char* name, FILE* file) {
+    char label_slow[25];
+    char label_done[25];
+
+    if (strcmp(name, "putchar") == 0) {
+        get_new_label(label_done);
+        fprintf(file,
+            "\tmov rax, qword [_output_length]\n"
+            "\tmov byte [_output_buffer + rax], dil\n"
+            "\tinc rax\n"
+            "\tmov qword [_output_length], rax\n"
+            "\tcmp rax, %d\n"
+            "\tjne %s\n"
+            "\tcall _flush\n"
+            "\t%s:\n",
+            RUNTIME_BUFFER_SIZE, label_done, label_done
+        );
+        stats.builtin_fast_paths++;
+        return true;
+    }
+
+    if (strcmp(name, "getchar") == 0) {
+        get_new_label(label_slow);
+        get_new_label(label_done);
+        fprintf(file,
+            "\tmov rax, qword [_input_position]\n"
+            "\tcmp rax, qword [_input_end]\n"
+            "\tjae %s\n"
+            "\tinc rax\n"
+            "\tmov qword [_input_position], rax\n"
+            "\tmovzx eax, byte [rax - 1]\n"
+            "\tjmp %s\n"
+            "\t%s:\n"
+            "\tcall getchar\n"
+            "\t%s:\n",
+            label_slow, label_done, label_slow, label_done
+        );
+        stats.builtin_fast_paths++;
+        return true;
     }
 
+    return false;
+}
+
+Type compile_function_call(Node* expr, FILE* file, Tables* tables) {
+    Type type;
+    type.type = TYPE_PRIMITIF;
+
+    Node* function_name = FIRSTCHILD(expr);
+    Type t = get_type(tables, function_name->ident);
+    CallGraphNode* callee = call_graph_get(tables->call_graph, tables->global, function_name->ident);
+
+    // an inlined body takes its arguments from the expression stack
+    bool inlined = t.type == TYPE_FUNCTION && should_inline(tables, callee, t.function.args_count, expr);
+    Type func_type = compile_call_arguments(expr, file, tables, !inlined);
+    compile_counter(file, expr, PROFILE_EXECUTIONS);
+
+    if (inlined) {
+        compile_inline_call(expr, file, tables, callee);
+
+        type.primitif = func_type.function.return_type;
+        return type;
+    }
+
+    if (options.optimize > 0 && compile_builtin_fast_path(function_name->ident, file)) {
+        push_value(file, tables, "rax");
+
+        type.primitif = func_type.function.return_type;
+        return type;
+    }
+
+    // the frame keeps rsp aligned, nothing to adjust around the call
     fprintf(file,  
         "\tcall %s\n",
         function_name->ident
     );
+    record_call(tables, function_name->ident, expr);
 
-    if (required_alignment) {
-        fprintf(file, "\tadd rsp, %d\n", required_alignment);
-    }
-    push_stack(file);
-
-    fprintf(file, "\tpush rax\n");
+    push_value(file, tables, "rax");
 
     type.primitif = func_type.function.return_type;
     return type;
-}
\ No newline at end of file
+}
+
+void compile_inline_call(Node* expr, FILE* file, Tables* tables, CallGraphNode* callee) {
+    Node* func = callee->function;
+    Node* header = FIRSTCHILD(func);
+    Node* parameters = THIRDCHILD(header);
+    Node* body = SECONDCHILD(func);
+
+    inline_budget -= callee->size;
+    if (options.inline_report) {
+        fprintf(stderr, "Line %d: %s inlined into %s (%d nodes, budget left %d)\n",
+            expr->lineno, callee->name, tables->function_name, callee->size, inline_budget);
+    }
+
+    // the callee variables get their own slots in the caller frame
+    SymbolTable* local = new_table();
+    local->size = tables->local->size;
+    fillSymbolTable(local, parameters);
+    fillSymbolTable(local, FIRSTCHILD(body));
+
+    Tables inline_tables = *tables;
+    inline_tables.local = local;
+    inline_tables.function_name = callee->name;
+    // the returns of the callee leave its value as is, only the caller has an accumulator
+    inline_tables.accumulator = 0;
+
+    Type func_type = get_type(tables, callee->name);
+    pop_arguments_to_slots(file, &inline_tables, parameters, func_type.function.args_count);
+
+    char label_return[25];
+    get_new_label(label_return);
+    inline_tables.return_label = label_return;
+    inline_tables.return_stack = stack_alignment;
+
+    fprintf(file, "\t; inline %s\n", callee->name);
+
+    inline_depth++;
+    compile_instructions(SECONDCHILD(body), file, &inline_tables);
+    inline_depth--;
+
+    // every return joins here with the result in rax
+    stack_alignment = inline_tables.return_stack;
+    tables->local->size = local->size;
+
+    fprintf(file, "\t%s:\n", label_return);
+    push_value(file, tables, "rax");
+
+    free_table(local);
+    free(local);
+}
@@ -6,11 +6,25 @@
 #include <stdbool.h>
 #include "tree.h"
 #include "SymbolTable.h"
+#include "CallGraph.h"
+
+#define ACCUMULATOR ".acc"
+
+// size of the input and output buffers of the runtime, BUFFER_SIZE in utils.asm
+#define RUNTIME_BUFFER_SIZE 65536
 
 typedef struct {
     char* function_name;
     SymbolTable* global;
     SymbolTable* local;
+    CallGraph* call_graph;
+    char* return_label;     // not NULL when the function is inlined into a caller
+    int return_stack;       // stack offset of the caller at the inlined call
+    char* body_label;       // start of the body, target of self tail calls
+    char accumulator;       // '+' or '*' when the self recursion feeds an accumulator
+    bool leaf;              // no frame pointer, locals are addressed from rsp
+    int frame_size;         // bytes reserved below the return address of a leaf
+    int outgoing_size;      // bottom of the frame, arguments past the sixth of a call
 } Tables;
 
 void get_new_label(char buffer[25]);
@@ -21,14 +35,23 @@ void insertDeclType(SymbolTable* table, Type var_type, Node* node);
 Type get_type(Tables* tables, char* value);
 int get_type_size(Type type);
 void get_string_address(Tables* tables, char* value, char buffer[25]);
+void get_variable_operand(Tables* tables, char* value, char buffer[40]);
+void load_variable(FILE* file, Tables* tables, char* value, char* target);
+void store_variable(FILE* file, Tables* tables, char* value, char* source);
+
+int get_character_value(char* character);
+bool get_constant_value(Node* expr, int* value);
+bool fold_operation(Node* expr, int a, int b, int* value);
 
 void compile_global_declarations(Node* declarations, FILE* file, SymbolTable* table);
-void compile_global_declaration(Node* declaration, FILE* file, Type var_type);
+void compile_global_declaration(Node* declaration, FILE* file, Type var_type, SymbolTable* table);
 
 void compile_prog(Node* tree, FILE* file);
 void declare_functions(Node* functions, Tables* tables);
 void compile_functions(Node* functions, FILE* file, Tables* tables);
 void compile_function(Node* func, FILE* file, Tables* tables);
+bool is_leaf(Node* node, char* name, char accumulator);
+void compile_epilogue(FILE* file, Tables* tables);
 
 
 bool compile_instructions(Node* instr, FILE* file, Tables* tables);
@@ -40,9 +63,13 @@ bool compile_while(Node* instr, FILE* file, Tables* tables);
 bool compile_switch(Node* instr, FILE* file, Tables* tables);
 bool compile_switch_instructions(Node* instr, FILE* file, Tables* tables, char label_break[25]);
 bool compile_return(Node* instr, FILE* file, Tables* tables);
+char find_accumulator(Node* instructions, char* name);
 
 
 Type compile_expression(Node* expr, FILE* file, Tables* tables);
+bool is_register_expression(Node* expr, Tables* tables);
+Type compile_register_expression(Node* expr, FILE* file, Tables* tables, int depth);
+void compile_condition(Node* expr, FILE* file, Tables* tables, char label[25], bool jump_if);
 
 Type compile_not(Node* expr, FILE* file, Tables* tables);
 Type compile_or(Node* expr, FILE* file, Tables* tables);
@@ -56,6 +83,9 @@ Type compile_num(Node* expr, FILE* file, Tables* tables);
 Type compile_character(Node* expr, FILE* file, Tables* tables);
 Type compile_ident(Node* expr, FILE* file, Tables* tables);
 Type compile_function_call(Node* expr, FILE* file, Tables* tables);
+Type compile_call_arguments(Node* expr, FILE* file, Tables* tables, bool to_registers);
+void pop_arguments_to_slots(FILE* file, Tables* tables, Node* parameters, int args_count);
+void compile_inline_call(Node* expr, FILE* file, Tables* tables, CallGraphNode* callee);
 
 
 #endif
\ No newline at end of file